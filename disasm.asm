@@ -6,6 +6,11 @@
 *-----------------------------------------------------------
 
             xdef    _disassemble
+            xdef    _decode_inst
+
+symbol_table equ    $00348             * monitor variable, pointer to symbol table or 0
+symbol_len  equ     12                 * maximum length of a symbol name
+
 _disassemble:   * Entry to disassembler using C calling convention
                 * void disassemble(ushort** addr, char* dest);
             link    a6,#0
@@ -20,6 +25,18 @@ _disassemble:   * Entry to disassembler using C calling convention
             unlk    a6
             rts
 
+_decode_inst:   * Entry to instruction decoder using C calling convention
+                * ushort decode_inst(ushort* addr, ulong* target);
+            movem.l d2-d5/a2-a3,-(a7)
+            move.l  28(a7),a2
+            bsr     decode_inst
+            move.l  32(a7),d2          * target wanted?
+            beq.s   .no_target
+            movea.l d2,a0
+            move.l  d1,(a0)
+.no_target  movem.l (a7)+,d2-d5/a2-a3
+            rts
+
 *=============================================================================
 *
 * Main entry to disassembler
@@ -46,7 +63,8 @@ _disassemble:   * Entry to disassembler using C calling convention
 *   advanced to next instruction on return.
 *   A4 must point to an output buffer where the disassembly string
 *   will be written. It is 0-terminated and opcode, operand and comment
-*   are separated by TAB characters. The buffer should be at least 50 bytes.
+*   are separated by TAB characters. The buffer should be at least 50 bytes,
+*   80 bytes when a symbol table is loaded.
 *
 *   Standard Motorola syntax is used and a ? and ^ character precede wrong
 *   operands:
@@ -58,6 +76,9 @@ _disassemble:   * Entry to disassembler using C calling convention
 *   line A and line F opcodes are marked in the comment field
 *
 *   PC-relative addresses are displayed using the actual operand address
+*   Branch targets, PC-relative and absolute long addresses are displayed
+*   as name+offset when symbol_table points to a table containing a symbol
+*   at or below the address, see makesym.py
 *=============================================================================
 
 disassemble_full                       * Disassemble with address and opcode
@@ -70,7 +91,24 @@ disassemble_full                       * Disassemble with address and opcode
 
 disassemble_inst                       * Disassemble instruction only
             move.w  (a2)+,d4           * store opcode for later
+            bsr.s   find_inst
+            lea     str_base(pc),a1    * opcode found, now dispatch to printer fct
+            adda.w  8(a3),a1           * offset in string table
+            cmpi.b  #';',(a1)          * opcode is a comment, don't print yet
+            beq.s   .dont_print
+            bsr     strapp
+.dont_print lea     op_base(pc),a0
+            adda.w  6(a3),a0           * offset in fct table
+            jsr     (a0)               * call special printer function
+            clr.b   (a4)               * terminate output string
+            rts
+
+find_inst                              * Find entry for opcode D4 in instructions, returns A3
             lea     instructions(pc),a3
+            move.w  d4,d0
+            rol.w   #5,d0
+            andi.w  #$1e,d0            * top nibble of opcode * 2
+            adda.w  (ins_index,pc,d0.w),a3 * start at group of top nibble
 
 .next       move.w  d4,d0
             and.w   (a3),d0            * test opcode bit pattern
@@ -78,18 +116,284 @@ disassemble_inst                       * Disassemble instruction only
             beq.s   .found
             adda.w  #10,a3
             bra.s   .next
+.found      rts
 
-.found      lea     str_base(pc),a1    * opcode found, now dispatch to printer fct
-            adda.w  8(a3),a1           * offset in string table
-            cmpi.b  #';',(a1)          * opcode is a comment, don't print yet
-            beq.s   .dont_print
-            bsr     strapp
-.dont_print lea     op_base(pc),a0
-            adda.w  6(a3),a0           * offset in fct table
-            jsr     (a0)               * call special printer function
-            clr.b   (a4)               * terminate output string
+ins_index                              * offsets of opcode groups in instructions
+            dc.w    0,ins_move-instructions,ins_move-instructions,ins_move-instructions
+            dc.w    ins_4-instructions,ins_5-instructions,ins_6-instructions,ins_7-instructions
+            dc.w    ins_8-instructions,ins_9-instructions,ins_a-instructions,ins_b-instructions
+            dc.w    ins_c-instructions,ins_d-instructions,ins_e-instructions,ins_f-instructions
+
+*=============================================================================
+*
+* Instruction decoder, finds length, flow class and static target of the
+* instruction at A2 without formatting it
+*
+*   Returns D0: flow class * 256 + length in bytes
+*           D1: static target or 0 if unknown
+*   Uses D2-D5, A0, A3, A2 is not changed
+*
+*   Flow classes:
+*   0 sequential
+*   1 branch (BRA, JMP)
+*   2 conditional branch (Bcc, DBcc)
+*   3 call (BSR, JSR)
+*   4 return (RTS, RTE, RTR)
+*   5 trap (TRAP, TRAPV), the target is the address of the vector
+*   6 exception (ILLEGAL, line A, line F, undefined), target is the vector
+*
+*   The target of JMP and JSR is only known for absolute and PC-relative
+*   addressing modes. Lengths of undefined opcodes are one word like in
+*   the disassembler.
+*=============================================================================
+
+flow_seq    equ     0
+flow_branch equ     1
+flow_cond   equ     2
+flow_call   equ     3
+flow_return equ     4
+flow_trap   equ     5
+flow_except equ     6
+
+decode_inst
+            move.w  (a2),d4            * opcode
+            bsr.s   find_inst
+            moveq   #0,d1              * no target
+            moveq   #flow_seq,d2
+            moveq   #2,d3              * length so far
+            cmpi.w  #op_unknown-op_base,6(a3)
+            beq.s   dec_except
+            cmpi.w  #op_move-op_base,6(a3) * also $0E00-$0FFF like the disassembler
+            beq     dec_move
+            move.w  d4,d0
+            lsr.w   #6,d0
+            andi.w  #3,d0
+            moveq   #1,d5
+            lsl.b   d0,d5              * size in bits 7..6: 1, 2, 4, or 8 if none
+            move.w  d4,d0
+            rol.w   #5,d0
+            andi.w  #$1e,d0            * top nibble of opcode * 2
+            move.w  (dec_index,pc,d0.w),d0
+            jmp     (dec_index,pc,d0.w)
+
+dec_index   dc.w    dec_0-dec_index,dec_move-dec_index,dec_move-dec_index,dec_move-dec_index
+            dc.w    dec_4-dec_index,dec_5-dec_index,dec_6-dec_index,dec_done-dec_index
+            dc.w    dec_arith-dec_index,dec_arith-dec_index,dec_done-dec_index,dec_arith-dec_index
+            dc.w    dec_arith-dec_index,dec_arith-dec_index,dec_e-dec_index,dec_done-dec_index
+
+dec_except  moveq   #flow_except,d2
+            moveq   #$10,d1            * illegal instruction vector
+            move.w  d4,d0
+            andi.w  #$f000,d0
+            cmpi.w  #$a000,d0
+            bne.s   .line_f
+            moveq   #$28,d1            * line A vector
+.line_f     cmpi.w  #$f000,d0
+            bne.s   dec_done
+            moveq   #$2c,d1            * line F vector
+            bra.s   dec_done
+
+dec_ea_op   move.w  d4,d0              * <ea> in low opcode bits
+            bsr.s   dec_ea
+            bra.s   dec_done
+
+dec_word    addq.w  #2,d3              * one extension word
+dec_done    tst.b   d2
+            bne.s   .flow
+            moveq   #0,d1              * no target for sequential flow
+.flow       move.l  d2,d0
+            lsl.w   #8,d0
+            move.b  d3,d0
             rts
 
+dec_ea                                 * add extension words of <ea> in D0, size D5
+            andi.w  #$3f,d0
+            cmpi.w  #$28,d0            * no extension for modes 0-4
+            blo.s   .none
+            cmpi.w  #$38,d0
+            blo.s   .word              * (d16,An), (d8,An,Xn)
+            beq.s   .abs_w
+            cmpi.w  #$3a,d0
+            blo.s   .abs_l
+            beq.s   .pc_rel
+            cmpi.w  #$3c,d0
+            blo.s   .word              * (d8,PC,Xn)
+            bhi.s   .none              * reserved
+            addq.w  #2,d3              * immediate
+            cmpi.b  #4,d5
+            beq.s   .word
+.none       rts
+.word       addq.w  #2,d3
+            rts
+.abs_w      move.w  0(a2,d3.w),d1
+            ext.l   d1
+            andi.l  #$ffffff,d1        * 24 bit address bus
+            addq.w  #2,d3
+            rts
+.abs_l      move.l  0(a2,d3.w),d1
+            andi.l  #$ffffff,d1
+            addq.w  #4,d3
+            rts
+.pc_rel     lea     0(a2,d3.w),a0
+            move.w  (a0),d1
+            ext.l   d1
+            add.l   a0,d1
+            addq.w  #2,d3
+            rts
+
+dec_0       btst    #8,d4
+            beq.s   .static
+            move.w  d4,d0
+            andi.w  #$38,d0
+            cmpi.w  #$08,d0            * MOVEP
+            beq     dec_word
+            moveq   #1,d5              * BTST etc. Dn,<ea>
+            bra     dec_ea_op
+.static     move.w  d4,d0
+            andi.w  #$0e00,d0
+            cmpi.w  #$0800,d0
+            bne.s   .imm
+            moveq   #1,d5              * BTST etc. #<data>,<ea>
+            addq.w  #2,d3
+            bra     dec_ea_op
+.imm        addq.w  #2,d3              * ORI ... CMPI #<data>,<ea>
+            cmpi.b  #4,d5
+            bne.s   .imm_ea
+            addq.w  #2,d3
+.imm_ea     cmpi.w  #op_log_to_ccr-op_base,6(a3)
+            beq     dec_done
+            cmpi.w  #op_log_to_sr-op_base,6(a3)
+            beq     dec_done
+            bra     dec_ea_op
+
+dec_move    move.w  d4,d0
+            rol.w   #4,d0
+            andi.w  #3,d0
+            move.b  (dec_msizes,pc,d0.w),d5
+            move.w  d4,d0
+            bsr     dec_ea             * source
+            move.w  d4,d1
+            andi.w  #$0fc0,d1          * destination mode and register
+            move.w  d1,d0
+            rol.w   #7,d0
+            lsr.w   #3,d1
+            andi.w  #$38,d1
+            or.w    d1,d0
+            bsr     dec_ea
+            bra     dec_done
+
+dec_msizes  dc.b    0,1,4,2
+
+dec_4       cmpi.w  #$4afc,d4          * ILLEGAL
+            beq     dec_except
+            move.w  d4,d0
+            andi.w  #$ffc0,d0
+            cmpi.w  #$4e40,d0
+            beq.s   .misc
+            cmpi.w  #$4e80,d0
+            beq.s   .jsr
+            cmpi.w  #$4ec0,d0
+            beq.s   .jmp
+            cmpi.w  #$4840,d0          * PEA
+            beq.s   .long
+            andi.w  #$fb80,d0
+            cmpi.w  #$4880,d0          * MOVEM or EXT
+            bne.s   .chk
+            moveq   #2,d5
+            btst    #6,d4
+            beq.s   .movem
+            moveq   #4,d5
+.movem      btst    #10,d4
+            bne.s   .list
+            move.w  d4,d0
+            andi.w  #$38,d0
+            beq     dec_done           * EXT
+.list       addq.w  #2,d3              * register list
+            bra     dec_ea_op
+.chk        move.w  d4,d0
+            andi.w  #$01c0,d0
+            cmpi.w  #$0180,d0          * CHK is word sized
+            bne.s   .lea
+            moveq   #2,d5
+.lea        cmpi.w  #$01c0,d0          * LEA is long sized
+            bne     dec_ea_op
+.long       moveq   #4,d5
+            bra     dec_ea_op
+.jsr        moveq   #flow_call,d2
+            bra.s   .long
+.jmp        moveq   #flow_branch,d2
+            bra.s   .long
+.misc       move.w  d4,d0              * $4E40-$4E7F
+            andi.w  #$3f,d0
+            cmpi.w  #$10,d0
+            blo.s   .trap
+            cmpi.w  #$18,d0
+            blo     dec_word           * LINK
+            cmpi.w  #$32,d0
+            beq     dec_word           * STOP
+            cmpi.w  #$36,d0
+            beq.s   .trapv
+            cmpi.w  #$33,d0
+            beq.s   .return            * RTE
+            cmpi.w  #$35,d0
+            beq.s   .return            * RTS
+            cmpi.w  #$37,d0
+            bne     dec_done
+.return     moveq   #flow_return,d2    * RTR
+            bra     dec_done
+.trap       lsl.w   #2,d0
+            addi.w  #$80,d0            * TRAP vector
+            move.w  d0,d1
+            moveq   #flow_trap,d2
+            bra     dec_done
+.trapv      moveq   #$1c,d1            * TRAPV vector
+            moveq   #flow_trap,d2
+            bra     dec_done
+
+dec_5       move.w  d4,d0
+            andi.w  #$f0f8,d0
+            cmpi.w  #$50c8,d0          * DBcc
+            bne     dec_ea_op          * ADDQ, SUBQ, Scc
+            moveq   #flow_cond,d2
+            bra.s   dec_disp16
+
+dec_6       moveq   #flow_cond,d2      * Bcc
+            move.w  d4,d0
+            andi.w  #$ff00,d0
+            cmpi.w  #$6000,d0
+            bne.s   .bsr
+            moveq   #flow_branch,d2    * BRA
+.bsr        cmpi.w  #$6100,d0
+            bne.s   .disp
+            moveq   #flow_call,d2      * BSR
+.disp       move.b  d4,d1
+            beq.s   dec_disp16
+            ext.w   d1
+            ext.l   d1
+            add.l   a2,d1
+            addq.l  #2,d1
+            bra     dec_done
+dec_disp16  move.w  2(a2),d1           * 16 bit displacement
+            ext.l   d1
+            add.l   a2,d1
+            addq.l  #2,d1
+            bra     dec_word
+
+dec_arith   cmpi.b  #8,d5              * ADDA, SUBA, CMPA, MULx, DIVx
+            bne     dec_ea_op
+            moveq   #2,d5
+            btst    #12,d4             * MULx and DIVx are word sized
+            beq     dec_ea_op
+            btst    #8,d4
+            beq     dec_ea_op
+            moveq   #4,d5              * xxxA.L
+            bra     dec_ea_op
+
+dec_e       cmpi.w  #op_shift-op_base,6(a3) * register shift
+            beq     dec_done
+            moveq   #2,d5              * memory shift is word sized
+            bra     dec_ea_op
+
 *============================================================
 * Inline coded formatting strings for opcode patterns
 *============================================================
@@ -395,8 +699,7 @@ branch_tgt  move.w  (a2),d0
             ext.l   d0
             add.l   a2,d0
             lea     2(a2),a2
-br_cont1    move.b  #'$',(a4)+
-            bra     print_addr24
+br_cont1    bra     print_target
 
 op_scc_ea                              * <op><cc>   <ea>
             bsr.s   print_cc
@@ -559,9 +862,8 @@ mode7       dbra    d0,.next71
             btst    #5,5(a3)           * absolute long, check if allowed
             bne.s   .ok_abl
             move.b  #'?',(a4)+
-.ok_abl     move.b  #'$',(a4)+
-            move.l  (a2)+,d0
-            bsr     print_addr24
+.ok_abl     move.l  (a2)+,d0
+            bsr     print_target
             move.b  #'.',(a4)+
             move.b  #'L',(a4)+
             rts
@@ -575,8 +877,7 @@ mode7       dbra    d0,.next71
             ext.l   d0
             add.l   a2,d0
             lea     2(a2),a2
-            move.b  #'$',(a4)+
-            bsr     print_addr24       * print result address (PC+offset)
+            bsr     print_target       * print result address (PC+offset)
             lea     str_pc(pc),a1
             bsr     strapp
             move.b  #')',(a4)+
@@ -591,10 +892,9 @@ mode7       dbra    d0,.next71
             ext.w   d0
             ext.l   d0
             add.l   a2,d0
-            move.b  #'$',(a4)+
-            bsr.s   print_addr24       * print result address (PC+offset)
+            bsr     print_target       * print result address (PC+offset)
             lea     str_pc(pc),a1
-            bsr.s   strapp
+            bsr     strapp
             move.b  #',',(a4)+
             move.w  (a2)+,d1           * reload extension word
             bra     print_index
@@ -606,7 +906,7 @@ mode7       dbra    d0,.next71
             bra.s   print_immediate
 
 .invalid_ea lea     str_inv_ea(pc),a1  * invalid adressing mode
-            bra.s   strapp
+            bra     strapp
 
 print_immediate
             move.b  #'#',(a4)+         * immediate data, size in d5 must be set
@@ -654,6 +954,58 @@ print_addr24                           * Print long in d0 as 24 bit address to b
             swap    d0
             bra.s   print_word
 
+print_target                           * Print address in d0 as name+offset if a symbol is found,
+            andi.l  #$ffffff,d0        * else as $ and 24 bit address
+            move.l  symbol_table.w,d1
+            beq.s   .hex
+            movea.l d1,a0
+            cmpi.w  #$5359,(a0)+       * 'SY' marks a valid table
+            bne.s   .hex
+            move.w  (a0)+,d1           * number of symbols, sorted by address
+            suba.l  a1,a1              * last symbol at or below d0
+            moveq   #0,d2
+            bra.s   .test
+
+.search     move.w  d1,d2              * binary search
+            lsr.w   #1,d2
+            lsl.l   #4,d2              * 16 bytes per symbol
+            cmp.l   0(a0,d2.l),d0
+            blo.s   .lower
+            lea     0(a0,d2.l),a1      * candidate, continue above
+            lea     16(a1),a0
+            lsr.l   #4,d2
+            sub.w   d2,d1
+            subq.w  #1,d1
+            bra.s   .test
+.lower      lsr.l   #4,d2              * continue below
+            move.w  d2,d1
+.test       tst.w   d1
+            bne.s   .search
+
+            move.l  a1,d1
+            beq.s   .hex
+            move.l  d0,d2
+            sub.l   (a1)+,d2           * offset to symbol
+            cmpi.l  #$ffff,d2
+            bhi.s   .hex
+            moveq   #symbol_len-1,d1
+.name       move.b  (a1)+,(a4)+        * copy name, upto symbol_len characters
+            dbeq    d1,.name
+            bne.s   .offset
+            subq.l  #1,a4              * remove 0 terminator
+.offset     tst.w   d2
+            beq.s   .done
+            move.b  #'+',(a4)+
+            move.b  #'$',(a4)+
+            move.w  d2,d0
+            cmpi.w  #$ff,d0
+            bls     print_byte
+            bra     print_word
+.done       rts
+
+.hex        move.b  #'$',(a4)+
+            bra     print_addr24
+
 strapp                                 * String append from a1 to a4
             move.b  (a1)+,(a4)+
             bne.s   strapp
@@ -845,6 +1197,9 @@ next_bit    addq.b  #1,d1
 *   5: xxx.W,xxx.L
 *   6: (d16,PC),(d8,PC,Xn)
 *   7: #data
+* Entries are grouped by the top nibble of the opcode and searched from
+* the group start given by ins_index. An entry must not match opcodes of
+* a group before its own, the first match wins.
 *======================================================================
 instructions
 
@@ -878,11 +1233,13 @@ instructions
 * $2... : MOVE.L
 * $3... : MOVE.W
 *----------------------------------------------------------------------
+ins_move
             dc.w    $c1c0,$0040,$ff02,op_move-op_base,str_movea-str_base
             dc.w    $c000,$0000,$ff3d,op_move-op_base,str_move-str_base
 *----------------------------------------------------------------------
 * $4... : a grabbag
 *----------------------------------------------------------------------
+ins_4
             dc.w    $ffc0,$40c0,$3d,op_from_sr-op_base,str_move-str_base
             dc.w    $ffc0,$44c0,$fd,op_to_ccr-op_base,str_move-str_base
             dc.w    $ffc0,$46c0,$fd,op_to_sr-op_base,str_move-str_base
@@ -918,6 +1275,7 @@ instructions
 *----------------------------------------------------------------------
 * $5... : ADDQ, SUBQ, Scc, DBcc
 *----------------------------------------------------------------------
+ins_5
             dc.w    $f0f8,$50c8,$00,op_dbcc_dn-op_base,str_db-str_base
             dc.w    $f0c0,$50c0,$3d,op_scc_ea-op_base,str_s-str_base
             dc.w    $f100,$5000,$3f,op_size_tiny_ea-op_base,str_add-str_base
@@ -925,16 +1283,19 @@ instructions
 *----------------------------------------------------------------------
 * $6... : BRA, BSR, Bcc
 *----------------------------------------------------------------------
+ins_6
             dc.w    $ff00,$6000,$00,op_branch-op_base,str_bra-str_base
             dc.w    $ff00,$6100,$00,op_branch-op_base,str_bsr-str_base
             dc.w    $f000,$6000,$00,op_cbranch-op_base,str_b-str_base
 *----------------------------------------------------------------------
 * $7... : MOVEQ
 *----------------------------------------------------------------------
+ins_7
             dc.w    $f100,$7000,$00,op_moveq-op_base,str_moveq-str_base
 *----------------------------------------------------------------------
 * $8... : OR, DIV, SBCD
 *----------------------------------------------------------------------
+ins_8
             dc.w    $f1f8,$8100,$00,op_ext_dn-op_base,str_sbcd-str_base
             dc.w    $f1f8,$8108,$00,op_ext_an-op_base,str_sbcd-str_base
             dc.w    $f1c0,$80c0,$fd,op_ea2_dn-op_base,str_divu-str_base
@@ -944,6 +1305,7 @@ instructions
 *----------------------------------------------------------------------
 * $9... : SUB, SUBX, SUBA
 *----------------------------------------------------------------------
+ins_9
             dc.w    $f0c0,$90c0,$ff,op_size_ea_an-op_base,str_sub-str_base
             dc.w    $f138,$9100,$00,op_size_ext_dn-op_base,str_sub-str_base
             dc.w    $f138,$9108,$00,op_size_ext_an-op_base,str_sub-str_base
@@ -952,10 +1314,12 @@ instructions
 *----------------------------------------------------------------------
 * $A... : Reserved, line A emulation
 *----------------------------------------------------------------------
+ins_a
             dc.w    $f000,$a000,$00,op_unknown-op_base,str_line_a-str_base
 *----------------------------------------------------------------------
 * $B... : EOR, CMP, CMPA, CMPM
 *----------------------------------------------------------------------
+ins_b
             dc.w    $f0c0,$b0c0,$ff,op_size_ea_an-op_base,str_cmp-str_base
             dc.w    $f138,$b108,$00,op_size_cmpm-op_base,str_cmpm-str_base
             dc.w    $f100,$b000,$ff,op_size_ea_dn-op_base,str_cmp-str_base
@@ -963,6 +1327,7 @@ instructions
 *----------------------------------------------------------------------
 * $C... : AND, MUL, ABCD, EXG
 *----------------------------------------------------------------------
+ins_c
             dc.w    $f1f8,$c140,$00,op_dx_dy-op_base,str_exg-str_base
             dc.w    $f1f8,$c148,$00,op_ax_ay-op_base,str_exg-str_base
             dc.w    $f1f8,$c188,$00,op_dx_ay-op_base,str_exg-str_base
@@ -975,6 +1340,7 @@ instructions
 *----------------------------------------------------------------------
 * $D... : ADD, ADDX, ADDA
 *----------------------------------------------------------------------
+ins_d
             dc.w    $f0c0,$d0c0,$ff,op_size_ea_an-op_base,str_add-str_base
             dc.w    $f138,$d100,$00,op_size_ext_dn-op_base,str_add-str_base
             dc.w    $f138,$d108,$00,op_size_ext_an-op_base,str_add-str_base
@@ -983,6 +1349,7 @@ instructions
 *----------------------------------------------------------------------
 * $E... : shifts and rotates
 *----------------------------------------------------------------------
+ins_e
             dc.w    $ffc0,$e0c0,$3c,op_simple_ea2-op_base,str_asr-str_base
             dc.w    $ffc0,$e1c0,$3c,op_simple_ea2-op_base,str_asl-str_base
             dc.w    $ffc0,$e2c0,$3c,op_simple_ea2-op_base,str_lsr-str_base
@@ -1002,6 +1369,7 @@ instructions
 *----------------------------------------------------------------------
 * $F... : Reserved, line F co-processor emulation
 *----------------------------------------------------------------------
+ins_f
             dc.w    $f000,$f000,$00,op_unknown-op_base,str_line_f-str_base
 *----------------------------------------------------------------------
 * $.... : undefined opcode
@@ -0,0 +1,131 @@
+/* bench_disasm.c  -  Regression test and benchmark for the disassembler
+ *
+ * Runs the disassembler over all 65536 first opcode words, each followed by the
+ * same fixed extension words. bench_disasm.prj links disasm.asm directly for the
+ * Ide68k simulator, bench_disasm_kit.prj calls the disassembler of the monitor ROM
+ * on the Kit.
+ *
+ * Pass 1 disassembles everything without output. On the Kit, started with SR 2100,
+ * it is timed with the 10 ms tick, giving real 68008 cycles at CPU_CLOCK. Without
+ * ticks (simulator) reset the cycle counter of the simulator before and enter its
+ * value after the pass. The simulator counts 68000 cycles, the 68008 needs 4 more
+ * cycles for every word it transfers over its 8 bit bus.
+ * Pass 2 computes a CRC-32 over all listing lines and compares it to GOLDEN_CRC.
+ * It also checks that decode_inst finds the same length as the disassembler.
+ * With listing enabled each line is printed as "oooo len<TAB>text", save the
+ * output window and compare it against bench_disasm.txt, the golden listing.
+ *
+ * The listing contains absolute addresses of PC-relative operands, so the opcode
+ * words are placed at the fixed address CODE_ADDR, and symbol_table is cleared.
+ */
+
+#include <stdio.h>
+#include "monitor4x.h"
+
+#define CPU_CLOCK   10000000L  // 68008 clock on the Kit, cycles per second
+#define CODE_ADDR   0x10000L   // fixed address of the opcode words, see golden listing
+#define GOLDEN_CRC  0x93a9f8d3L // CRC-32 of bench_disasm.txt
+
+#if GOLDEN_CRC == 0
+#error "GOLDEN_CRC must be the CRC-32 of the golden listing bench_disasm.txt"
+#endif
+
+static const ushort ext_words[6] = { 0, 0x1234, 0x5678, 0x9abc, 0xdef0, 0x2468 };
+static ushort *code = (ushort *) CODE_ADDR;
+static char   line[80];
+static ulong  len_errors;
+
+ulong crc32_line(const char *p, ulong crc)
+{
+  int i;
+  while (*p) {
+    crc ^= (unsigned char)*p++;
+    for (i=0; i<8; i++)
+      crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320L : crc >> 1;
+  }
+  return crc;
+}
+
+ulong pass_timed(void)
+{
+  ulong op, words = 0;
+  ushort *pc;
+  for (op=0; op<0x10000L; op++) {
+    code[0] = op;
+    pc = code;
+    disassemble(&pc, line);
+    words += pc - code;
+  }
+  return words;
+}
+
+ulong pass_check(int list)
+{
+  ulong op, crc = 0xffffffffL;
+  ushort *pc;
+  char head[12];
+  for (op=0; op<0x10000L; op++) {
+    code[0] = op;
+    pc = code;
+    disassemble(&pc, line);
+    if ((decode_inst(code, 0) & 0xff) != (pc - code) * 2)
+      len_errors++;
+    sprintf(head, "%04lx %d\t", op, (int)(pc - code));
+    crc = crc32_line(head, crc);
+    crc = crc32_line(line, crc);
+    crc = crc32_line("\n", crc);
+    if (list)
+      printf("%s%s\n", head, line);
+  }
+  return ~crc;
+}
+
+void main(void)
+{
+  ulong words, ticks, cycles = 0, crc;
+  ushort *symbols = *symbol_table;
+  const char *cpu = "68008";
+  int list, i;
+
+  for (i=0; i<6; i++)
+    code[i] = ext_words[i];
+  *symbol_table = 0; // no names in the listing
+  printf("Disassembler benchmark, code at %06lx\n", (ulong)code);
+  printf("In the simulator reset the cycle counter, then press Enter ");
+  getchar();
+  ticks = *tick_100hz;
+  words = pass_timed();
+  ticks = *tick_100hz - ticks;
+  printf("Done, %lu words decoded", words);
+  if (ticks)
+    cycles = ticks * (CPU_CLOCK / 100); // measured on the Kit
+  else {
+    cpu = "68000";
+    printf(". Enter cycle counter: ");
+    scanf("%lu", &cycles);
+  }
+  printf("\n");
+  if (cycles >= 0x10000L) {
+    // cycles / 65536 with 2 decimals, instructions per second 16*CPU_CLOCK / (cycles / 4096)
+    printf("%lu.%02lu %s cycles per instruction\n", cycles >> 16,
+           ((cycles & 0xffffL) * 100) >> 16, cpu);
+    printf("%lu instructions per second on a %s at %ld MHz\n", CPU_CLOCK * 16 / (cycles >> 12),
+           cpu, CPU_CLOCK / 1000000L);
+  }
+
+  printf("List all opcodes (0/1)? ");
+  list = 0;
+  scanf("%d", &list);
+  crc = pass_check(list);
+  printf("CRC-32 of listing %08lx", crc);
+  if (crc == GOLDEN_CRC)
+    printf(", matches golden CRC\n");
+  else
+    printf(", MISMATCH, golden CRC is %08lx\n", GOLDEN_CRC);
+  printf("decode_inst length differs for %lu opcodes\n", len_errors);
+  if (crc != GOLDEN_CRC || len_errors)
+    printf("FAIL, list all opcodes and diff against bench_disasm.txt\n");
+  else
+    printf("PASS\n");
+  *symbol_table = symbols;
+}
@@ -5,7 +5,7 @@
 
 void main(void)
 {
-  static char buf[50];
+  static char buf[80];
   ushort* pc = &main; // disassemble ourselves;
   int loop = 1;
 
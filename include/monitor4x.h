@@ -21,6 +21,23 @@ extern void lcd_clear(void);
 extern void lcd_defchar(char udc, const char* bits);
 extern void monitor_loop(void);
 extern char monitor_scan(void);
+extern void write_block(const char* buf, int len);
+extern ulong crc32(const char* buf, ulong len, ulong crc);
+extern ushort fletcher16(const char* buf, ulong len);
+extern ushort decode_inst(const ushort* addr, ulong* target);
+extern void lcd_flush(void);
+extern int get_key(void);
+
+// Result of decode_inst: flow class * 256 + instruction length in bytes
+#define INST_LEN(d)   ((d) & 0xff)
+#define INST_FLOW(d)  ((d) >> 8)
+#define FLOW_SEQ      0 // sequential
+#define FLOW_BRANCH   1 // BRA, JMP
+#define FLOW_COND     2 // Bcc, DBcc
+#define FLOW_CALL     3 // BSR, JSR
+#define FLOW_RETURN   4 // RTS, RTE, RTR
+#define FLOW_TRAP     5 // TRAP, TRAPV, target is the vector address
+#define FLOW_EXCEPT   6 // ILLEGAL, line A/F, undefined opcode, target is the vector address
 
 /*****************************************************************************
 *  68008 kit I/O locations
@@ -43,8 +60,8 @@ extern char monitor_scan(void);
 #define hexdump_lines ((ushort *) 0x0026e) // number of lines of hexdump
 #define disasm_on_lcd ((char *)   0x00270) // 0 to suppress displaying current instruction on LCD
 #define enable_trap1  ((char *)   0x00272) // 0 to skip over TRAP 1, 1 to break at TRAP 1
-#define delay_b1      ((uint *)   0x0027c) // delay1 for UART, 2400: 0x1a, 4800: 0x0a, 9600: 0x02
-#define delay_b2      ((uint *)   0x00280) // delay2 for UART, 2400: 0x2b, 4800: 0x15, 9600: 0x06
+#define delay_b1      ((uint *)   0x0027c) // delay1 for UART, bit time, computed from baud_rate
+#define delay_b2      ((uint *)   0x00280) // delay2 for UART, 1.5 bit time, computed from baud_rate
 #define user_data(n)  ((ulong *)  (0x002a6+4*(n))) // 8 elements, data registers D0-D7
 #define user_addr(n)  ((ulong *)  (0x002c6+4*(n))) // 7 elements, address registers A0-A6
 #define user_usp      ((ulong *)  0x002e2) // user stack pointer USP
@@ -56,5 +73,13 @@ extern char monitor_scan(void);
 #define lcd_lines     ((uchar *)  0x00302) // height of LCD, typically 1, 2, 4
 #define lcd_present   ((char *)   0x00304) // 0 if LCD is missing, 1 if present
 #define shift_size    ((ushort *) 0x00306) // size of block to be shifted on INS and DEL, usually 512
+#define baud_rate     ((ulong *)  0x0033c) // bit rate of software UART, change with SHIFT TEST
+#define hexdump_width ((ushort *) 0x00340) // bytes per line of hexdump, 1-32
+#define hexdump_group ((ushort *) 0x00342) // bytes per group of hexdump, 1, 2 or 4
+#define flow_control  ((char *)   0x00346) // 1 to send XON/XOFF around downloads and command lines
+#define symbol_table  ((ushort **) 0x00348) // symbol table for disassembler, see makesym.py, or 0
+#define disasm_cycles ((char *)   0x00372) // 1 to append 68008 cycles to disassembly listings
+#define lcd_async     ((char *)   0x003c8) // 1 to send LCD output from the tick interrupt, cleared on reset
+#define key_irq       ((char *)   0x003f0) // 1 to scan keys and LEDs in the tick interrupt, cleared on reset
 
 #endif
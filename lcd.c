@@ -3,11 +3,35 @@ char *const LCD_data_write = (char *)    0x60001;
 char *const LCD_command_read = (char *)  0x60002;
 char *const LCD_data_read = (char *)     0x60003;
 
+#include "lcd.h"
+
 #define BUSY 0x80
 
+// The shadow holds all 80 bytes of display RAM, in the order the LCD increments
+// its address: line 0 and 2 at 0x00-0x27, then line 1 and 3 at 0x40-0x67.
+// Writes to cells that already hold the character are skipped, the hardware
+// address is only set when the next changed cell isn't the following one.
+#define LCD_CLEAR_MAX 32 // more non-blank cells are cleared with the slow clear command
+
+// With lcd_async set, a changed cell is only marked in lcd_dirty. service_tick
+// sends upto LCD_DRAIN dirty cells from the shadow, so a full screen always fits
+// and a cell changed again before it was sent costs nothing. Between the writes
+// of a tick the LCD is polled upto LCD_POLL times, about the 40 us one write takes.
+// lcd_lock keeps the tick away while lcd_dirty is changed or flushed by the caller.
+#define LCD_DRAIN     8  // cells sent per tick
+#define LCD_POLL      10 // busy polls per write in the tick
+#define LCD_CMD       0x100
+
 extern char lcd_present;
 extern uchar lcd_width;
 extern uchar lcd_lines;
+extern char lcd_shadow[LCD_CELLS];
+extern char lcd_pos;   // cell index of the next character
+extern char lcd_hw;    // cell index of the LCD address counter, -1 if unknown
+extern char lcd_async;
+extern char lcd_lock;
+extern char lcd_pending;
+extern uchar lcd_dirty[LCD_DIRTY];
 
 int LcdReady(void)
 {
@@ -17,37 +41,188 @@ int LcdReady(void)
   return timeout;
 }
 
+
+// Wait upto polls times for the LCD, returns 0 if it is still busy
+int lcd_wait(int polls)
+{
+  while (*LCD_command_read&BUSY)
+    if (--polls < 0)
+      return 0;
+  return 1;
+}
+
+
+// Index of the first dirty cell from cell i on, wrapping around, or -1 if none
+char next_dirty(char i)
+{
+  char n;
+  if ((uchar)i >= LCD_CELLS)
+    i = 0;
+  for (n=0; n<LCD_CELLS; n++) {
+    if (lcd_dirty[i>>3] == 0) { // skip the rest of a clean byte
+      n += 7 - (i&7);
+      i |= 7;
+    }
+    else if (lcd_dirty[i>>3] & (1 << (i&7)))
+      return i;
+    if (++i >= LCD_CELLS)
+      i = 0;
+  }
+  return -1;
+}
+
+
+// Send dirty cell i from the shadow, setting the LCD address first if needed.
+// Returns 0 and leaves the cell dirty if the LCD stays busy for polls polls.
+int send_cell(char i, int polls)
+{
+  if (lcd_hw != i) {
+    if (!lcd_wait(polls))
+      return 0;
+    *LCD_command_write = i < 40 ? 0x80+i : 0xC0-40+i;
+    lcd_hw = i;
+  }
+  if (!lcd_wait(polls))
+    return 0;
+  *LCD_data_write = lcd_shadow[i];
+  lcd_dirty[i>>3] &= ~(1 << (i&7));
+  lcd_hw = i + 1 < LCD_CELLS ? i + 1 : 0;
+  return 1;
+}
+
+
+// Send all dirty cells, waiting for the LCD
+void lcd_flush(void)
+{
+  char i;
+  lcd_lock = 1;
+  while ((i = next_dirty(lcd_hw)) >= 0)
+    if (!send_cell(i, 200))
+      break; // LCD doesn't respond
+  lcd_pending = 0;
+  lcd_lock = 0;
+}
+
+
+// Called from service_tick if lcd_pending is set and lcd_lock isn't. Waits for
+// the LCD only as long as a write takes, a busy LCD after a clear or CGRAM write
+// leaves the cells for the next tick.
+void lcd_tick(void)
+{
+  char n, i;
+  for (n=0; n<LCD_DRAIN; n++) {
+    if ((i = next_dirty(lcd_hw)) < 0) {
+      lcd_pending = 0;
+      break;
+    }
+    if (!send_cell(i, LCD_POLL))
+      break;
+  }
+}
+
+
+// Send a command or data byte, waiting for the LCD, after the dirty cells
+void lcd_write(ushort w)
+{
+  if (lcd_pending)
+    lcd_flush(); // left over from async mode
+  LcdReady();
+  if (w & LCD_CMD)
+    *LCD_command_write=w;
+  else
+    *LCD_data_write=w;
+}
+
+// Clear the LCD and the shadow with the clear command
+void clear_lcd_hw(void)
+{
+  char i;
+  lcd_write(LCD_CMD|0x01);
+  for (i=0; i<LCD_CELLS; i++)
+    lcd_shadow[i] = ' ';
+  lcd_pos = lcd_hw = 0;
+}
+
+
+// Write a character at lcd_pos if the cell holds a different one,
+// or only mark the cell dirty in async mode
+void put_cell(char ch)
+{
+  if (lcd_shadow[lcd_pos] != ch) {
+    lcd_shadow[lcd_pos] = ch;
+    if (lcd_async) {
+      lcd_lock = 1;
+      lcd_dirty[lcd_pos>>3] |= 1 << (lcd_pos&7);
+      lcd_pending = 1;
+      lcd_lock = 0;
+    }
+    else {
+      if (lcd_pending)
+        lcd_flush(); // before lcd_hw is used
+      if (lcd_hw != lcd_pos)
+        lcd_write(LCD_CMD | (lcd_pos < 40 ? 0x80+lcd_pos : 0xC0-40+lcd_pos));
+      lcd_write((uchar)ch);
+      lcd_hw = lcd_pos + 1 < LCD_CELLS ? lcd_pos + 1 : 0;
+    }
+  }
+  if (++lcd_pos >= LCD_CELLS)
+    lcd_pos = 0;
+}
+
+
 void clr_screen(void)
 {
+  char i, n;
   if (lcd_present) {
-    LcdReady();
-    *LCD_command_write=0x01;
+    for (i=n=0; i<LCD_CELLS; i++)
+      if (lcd_shadow[i] != ' ')
+        n++;
+    if (n > LCD_CLEAR_MAX && !lcd_async) // async mode marks the cells instead of waiting
+      clear_lcd_hw();
+    else {
+      for (lcd_pos=0; n>0; )
+        if (lcd_shadow[lcd_pos] != ' ') {
+          put_cell(' ');
+          n--;
+        }
+        else
+          lcd_pos++;
+      lcd_pos = 0;
+    }
   }
 }
 
 
+// Only moves the shadow position, the address is sent with the next changed cell
 void goto_xy(int x,int y)
 {
   if (lcd_present) {
-    LcdReady();
     switch (y) {
-      case 0: *LCD_command_write=0x80+x; break;
-      case 1: *LCD_command_write=0xC0+x; break;
-      case 2: *LCD_command_write=0x94+x; break;
-      case 3: *LCD_command_write=0xd4+x; break;
+      case 0: lcd_pos = x; break;
+      case 1: lcd_pos = 40+x; break;
+      case 2: lcd_pos = 20+x; break;
+      case 3: lcd_pos = 60+x; break;
     }
+    if ((uchar)lcd_pos >= LCD_CELLS)
+      lcd_pos = 0;
   }
 }
 
 
 void InitLcd(void)
 {
+  char i;
+  lcd_lock = 1;
+  for (i=0; i<LCD_DIRTY; i++)
+    lcd_dirty[i] = 0; // drop unsent cells
+  lcd_pending = 0;
+  lcd_lock = 0;
   lcd_present = LcdReady() < 100;
   *LCD_command_write=0x38;
   LcdReady();
   *LCD_command_write=0x0c;
-  clr_screen();
-  goto_xy(0,0);
+  if (lcd_present)
+    clear_lcd_hw();
 }
 
 
@@ -55,20 +230,16 @@ char *Puts(char *str)
 {
   unsigned char i;
   if (lcd_present) {
-    for (i=0; str[i] != '\0'; i++) {
-      LcdReady();
-      *LCD_data_write=str[i];
-    }
+    for (i=0; str[i] != '\0'; i++)
+      put_cell(str[i]);
   }
   return str;
 }
 
 void putch_lcd(char ch)
 {
-  if (lcd_present) {
-    LcdReady();
-    *LCD_data_write=ch;
-  }
+  if (lcd_present)
+    put_cell(ch);
 }
 
 
@@ -76,11 +247,9 @@ void def_char(char ch, char* bits)
 {
   unsigned char i;
   if (lcd_present) {
-    LcdReady();
-    *LCD_command_write=0x40|(ch<<3);
-    for (i=0; i<8; i++) {
-      LcdReady();
-      *LCD_data_write=bits[i];
-    }
+    lcd_write(LCD_CMD | 0x40 | (ch<<3));
+    for (i=0; i<8; i++)
+      lcd_write((uchar)bits[i]);
+    lcd_hw = -1; // address counter now points into character RAM
   }
 }
\ No newline at end of file
@@ -0,0 +1,4 @@
+// Sizes of the LCD variables, which main.c places below 0x00400 and lcd.c uses
+
+#define LCD_CELLS 80             // bytes of display RAM, all 4 lines of 20 characters
+#define LCD_DIRTY (LCD_CELLS/8)  // bytes of the dirty bitmap, one bit per cell
@@ -7,7 +7,7 @@
 // SSP and boot vector are stored at location 0-7 in ROM.
 // trap #0 is for monitor return from user code.
 // Serial port is 2400 bit/s 8n1.
-// Hex files for downloading accept S1 and S2, 16-bit address and 24-bit address
+// Hex files for downloading accept S1, S2 and S3, 16, 24 and 32-bit address
 // Development Tool: IDE68k v3.0
 // project files include
 //  cswitches.a68
@@ -82,6 +82,33 @@
 // * cleanup project structure
 // * chase pointers in memory
 //
+// V 4.9 news:
+//
+// * selectable bit rate and auto-baud for software UART
+// * software UART in assembly, 8 data bits, upto 38400 bit/s
+// * block transmit service, terminal output built as lines
+// * XMODEM-CRC/1K binary download
+// * compressed download, decompressed while receiving
+// * s-record loader in assembly with S3/S7 records and load summary
+// * hexdump with configurable width and grouping, repeated lines shown as '*'
+// * save memory range to terminal as s-records or base64
+// * CRC-32 and Fletcher-16 of memory range, also as services
+// * command line on the terminal for scripted operation
+// * GDB remote serial protocol stub
+// * optional XON/XOFF flow control for downloads and command line
+// * faster disassembler with opcode group index
+// * symbol names in disassembly from a downloaded symbol table
+// * decode_inst for length, flow class and target without disassembling
+// * key - finds the start of multiword instructions again
+// * optional 68008 cycle estimates in disassembly listings
+// * LCD is written through a shadow copy, only changed characters
+// * optional LCD output through the tick interrupt, changed cells are marked in a bitmap
+// * optional key scanning in the tick interrupt with key FIFO, get_key service
+// * 64 breakpoints in the monitor area at top of RAM, fast lookup when tracing
+// * conditional breakpoints, evaluated in the TRAP #3 and trace handlers
+// * hit counters and ignore counts for breakpoints
+// * data watchpoints, checked in trace mode
+//
 //////////////////////////////////////////////////////////
 
 typedef unsigned char  uchar;
@@ -98,35 +125,84 @@ void step_out(void);
 void step_then_go(void);
 void disarm_breakpoints(void);
 void enable_level2(void);
+ulong measure_frame(void);
+void send_byte(char n);
+char get_byte(void);
+void write_block(char *buf, int len);
+int  get_byte_timeout(ulong polls);
+int  get_line(char *buf, int max);
+int  get_packet(char *buf, int max);
+int  receive_block(char *buf, int len, ulong polls);
+int  receive_lz(char *dest, ulong len, ulong polls);
+void load_srec(int c, ulong *stat);
+ushort crc16(const char *buf, ulong len, ushort crc);
+ulong crc32(const char *buf, ulong len, ulong crc);
+ushort fletcher16(const char *buf, ulong len);
 
 // C function prototypes
 void InitLcd(void);
 char *Puts(char *str);
 void clr_screen(void);
 void goto_xy(int x,int y);
+void lcd_flush(void);
 void send_long_hex(ulong n);
 void read_memory(void);
 void key_data(void);
 void pstring(char *s);
 void disassemble(ushort** addr, char* dest);
+ushort decode_inst(const ushort* addr, ulong* target);
 void disassemble_lcd(void);
-ushort *dump_disassembly(ushort* addr);
+ulong inst_end(void);
+void cache_inst(void);
+ulong find_inst_start(void);
+ushort *dump_disassembly(ushort* addr, ulong* total);
+int  inst_cycles(ushort* addr);
 void print_led(int offset, const char* text);
 void display_register(ulong *reg);
 void dot_register(void);
-void format_sr(void);
+char *format_sr(char *dest);
 void newline(void);
 int  breakpoint_at(ulong address);
+int  set_baud(ulong rate);
+void step_baud(short dir);
+void key_auto_baud(void);
+void gdb_stub(void);
+char *hex2buf(char *dest, ulong n, short digits);
+char *format_dec(char *dest, ulong n);
+char *str2buf(char *dest, const char *src);
+void send_line(char *end);
 
 
+#include "lcd.h"
+
 // Symbolic constants
-#define VERSION "V4.8"
-#define INIT_SSP 0x20000
-#define INIT_USP 0x1fc00
+#define VERSION "V4.9"
+#define INIT_SSP 0x1fc00   // below the monitor area at the top of RAM
+#define INIT_USP 0x1f800
 #define INIT_PC  0x00400
 #define INIT_SR  0x2700
 
-#define MAX_BP   8
+#define MON_AREA 0x1fc00   // 1 kByte of monitor tables at the top of RAM
+#define MAX_BP   64
+#define BP_FILTER 256      // bits in bp_filter, indexed by bits 1-8 of the address
+#define MAX_COND 16        // breakpoints with a condition
+
+// Breakpoint conditions: (operand & mask) op value, unsigned
+#define COND_EQ  1         // =
+#define COND_NE  2         // !
+#define COND_LT  3         // <
+#define COND_GT  4         // >
+#define COND_REG 0x000     // size in high byte of cond_op, operand is register 0-7 D0-D7, 8-14 A0-A6
+#define COND_B   0x100     // operand is byte at address
+#define COND_W   0x200     // word
+#define COND_L   0x400     // long
+#define NO_COND  1         // cond_addr of an unused entry, never a breakpoint address
+#define MAX_WATCH 4        // watchpoints
+#define WATCH_EQ 1         // in watch_mode: stop only when the value changes to watch_target
+
+#if MAX_COND != 16 || MAX_WATCH != 4
+#error "change max_cond and max_watch in services.asm as well"
+#endif
 
 // Monitor states
 #define STATE_AFTER_RESET     0
@@ -140,6 +216,67 @@ int  breakpoint_at(ulong address);
 #define STATE_INPUT_REGISTER 13
 #define STATE_SHOW_REGISTER  14
 #define STATE_TOGGLE_TRAP1   15
+#define STATE_BAUD           16
+#define STATE_CHECKSUM       17
+
+
+// Software UART timing in CPU cycles, see send_byte/get_byte in services.asm
+#define CPU_CLOCK      10000000
+#define UART_LOOP          18   // one iteration of the delay loop
+#define UART_OVERHEAD     100   // fixed cost of each bit besides the delay loop
+#define UART_START        178   // fixed cost from start bit edge to sampling D0
+#define SAMPLE_CYCLES      50   // one iteration of the sampling loop in measure_frame
+#define DEFAULT_BAUD     9600
+#define TIMEOUT_1S     160000   // polls of get_byte_timeout in one second
+
+// XMODEM control characters
+#define SOH  0x01
+#define STX  0x02
+#define EOT  0x04
+#define ACK  0x06
+#define NAK  0x15
+#define CAN  0x18
+
+// Software flow control
+#define XON  0x11
+#define XOFF 0x13
+#define MAX_RETRY  10
+
+// s-record load statistics, filled by load_srec
+#define SREC_RECORDS 0
+#define SREC_BYTES   1
+#define SREC_LOW     2
+#define SREC_HIGH    3
+#define SREC_ENTRY   4
+#define SREC_ERR     5   // number of check sum errors, followed by their addresses
+#define MAX_SREC_ERR 8   // srec_errors in services.asm
+
+#define MAX_HEX_WIDTH 32 // bytes per line of hexdump
+
+#define SAVE_SREC_BYTES 32 // data bytes per saved s-record
+#define SAVE_B64_BYTES  48 // bytes per line of base64 save
+
+#define CMD_LEN 80         // length of terminal command line
+#define CMD_LINE 1         // cmd_mode for command line
+#define CMD_GDB  2         // cmd_mode for GDB remote protocol
+
+// Result of decode_inst: flow class * 256 + instruction length in bytes
+#define INST_LEN(d)  ((d) & 0xff)
+#define INST_FLOW(d) ((d) >> 8)
+#define INST_CACHE   8     // instruction starts remembered for key - (power of 2)
+#define MAX_RESYNC   1024  // max. bytes to decode forward from an anchor for key -
+#define KEY_FIFO     4     // key events buffered by key_tick (power of 2)
+#define KEY_STABLE   2     // ticks a key must be stable to count as pressed or released
+#define FLOW_SEQ     0     // sequential
+#define FLOW_BRANCH  1     // BRA, JMP
+#define FLOW_COND    2     // Bcc, DBcc
+#define FLOW_CALL    3     // BSR, JSR
+#define FLOW_RETURN  4     // RTS, RTE, RTR
+#define FLOW_TRAP    5     // TRAP, TRAPV, target is the vector address
+#define FLOW_EXCEPT  6     // ILLEGAL, line A/F, undefined, target is the vector address
+
+#define GDB_BUF  400       // GDB packet size
+#define GDB_REGS 18        // D0-D7, A0-A7, SR, PC
 
 
 // 68008 kit I/O locations
@@ -148,6 +285,21 @@ char *const port0 = (char *) 0x80000;   // key input
 char *const port1 = (char *) 0x80002;   // digit driver
 char *const port2 = (char *) 0xA0000;   // segment driver
 
+// Breakpoint tables in the monitor area, too large for the variables below 00400
+ulong  *const break_points = (ulong *)  MON_AREA;              // sorted addresses of breakpoints
+ushort *const orig_instr   = (ushort *) (MON_AREA + 4*MAX_BP); // original instructions
+ulong  *const cond_addr    = (ulong *)  (MON_AREA + 6*MAX_BP); // breakpoints with condition, or NO_COND
+ulong  *const cond_src     = (ulong *)  (MON_AREA + 6*MAX_BP + 4*MAX_COND);  // register or address
+ulong  *const cond_value   = (ulong *)  (MON_AREA + 6*MAX_BP + 8*MAX_COND);  // compared to operand
+ulong  *const cond_mask    = (ulong *)  (MON_AREA + 6*MAX_BP + 12*MAX_COND); // applied to operand
+ushort *const cond_op      = (ushort *) (MON_AREA + 6*MAX_BP + 16*MAX_COND); // size | COND_EQ..COND_GT
+ushort *const bp_hits      = (ushort *) (MON_AREA + 6*MAX_BP + 18*MAX_COND); // hits of break_points, upto FFFF
+ushort *const bp_ignore    = (ushort *) (MON_AREA + 8*MAX_BP + 18*MAX_COND); // hits to continue after
+ulong  *const watch_addr   = (ulong *)  (MON_AREA + 10*MAX_BP + 18*MAX_COND);  // watched addresses
+ulong  *const watch_old    = (ulong *)  (MON_AREA + 10*MAX_BP + 18*MAX_COND + 4*MAX_WATCH);  // last value
+ulong  *const watch_target = (ulong *)  (MON_AREA + 10*MAX_BP + 18*MAX_COND + 8*MAX_WATCH);  // for WATCH_EQ
+ulong  *const watch_mode   = (ulong *)  (MON_AREA + 10*MAX_BP + 18*MAX_COND + 12*MAX_WATCH); // size<<8 | WATCH_EQ
+
 
 // Bit patterns for LED segments
 char const convert[]= {
@@ -199,19 +351,19 @@ char   enable_trap1;   // 1 -> TRAP #1 stops program, 0 -> TRAP #1 is ignored
 
 // delay counters
 int    glob_d;
-uint   glob_j;
-uint   glob_b1;        // Counter for delay_bit
-uint   glob_b2;        // Counter for delay_15bit
-uchar  glob_n;
-char   glob_i;
+uint   glob_j;         // unused since 4.9
+uint   glob_b1;        // bit delay of software UART
+uint   glob_b2;        // 1.5 bit delay from start bit to D0
+uchar  glob_n;         // unused since 4.9
+char   glob_i;         // unused since 4.9
 
-char   bcc_error;      // flag for checking bcc error
+char   bcc_error;      // unused since 4.9
 char   bcc;
-char   save_bcc;
+char   save_bcc;       // unused since 4.9
 
 ulong  start, end;
 ulong  display_PC, save_PC;
-ushort *curr_inst, *next_inst;
+ushort *curr_inst, *next_inst; // next_inst unused since 4.9
 
 // User registers
 ulong  user_data[8];   // D0-D7
@@ -238,69 +390,89 @@ ushort shift_size;     // number of bytes to shift with INS and DEL
 // new in 4.7
 short  num_bp;               // number of active breakpoints
 char   bp_armed;             // breakpoints armed
-ulong  break_points[MAX_BP]; // addresses of breakpoints
-ushort orig_instr[MAX_BP];   // original instructions
+ulong  bp_filter[BP_FILTER/32]; // set bit if a breakpoint may be at address, was break_points before 4.9
+short  num_watch;            // number of watchpoints, was orig_instr before 4.9
+ulong  bp_rearm;             // breakpoint to patch again after one trace step, was orig_instr
+ushort orig_instr_old[5];    // unused since 4.9, breakpoint tables are in MON_AREA
+
+// new in 4.9
+ulong  baud_rate;            // current bit rate of software UART
+ushort hexdump_width;        // bytes per line of hexdump, upto MAX_HEX_WIDTH
+ushort hexdump_group;        // bytes per group of hexdump: 1, 2 or 4
+char   cmd_mode;             // CMD_LINE or CMD_GDB when active on terminal
+char   flow_control;         // send XON/XOFF when set
+ushort *symbol_table;        // symbols for disassembler, see makesym.py, or 0
+ulong  inst_anchor;          // last address entered, start of an instruction
+ulong  inst_cache[INST_CACHE]; // instruction starts left with key +, for key -
+char   inst_cache_pos;       // next entry of inst_cache to replace
+char   disasm_cycles;        // append estimated 68008 cycles to disassembly listings
+char   lcd_shadow[LCD_CELLS]; // copy of LCD display RAM, only changed cells are written
+char   lcd_pos;              // shadow index of the next character on the LCD
+char   lcd_hw;               // shadow index of the LCD address counter, -1 if unknown
+char   lcd_async;            // only mark changed cells, service_tick sends them
+char   lcd_lock;             // keeps service_tick away while lcd_dirty is changed
+char   lcd_pending;          // set when cells may be dirty, cleared by service_tick
+uchar  lcd_dirty[LCD_DIRTY]; // cells changed in lcd_shadow but not yet on the LCD
+char   lcd_spare[24];        // free, keeps key_irq at 0x003f0
+char   key_irq;              // scan keys and LEDs in service_tick
+char   key_last;             // scan code of the last tick
+char   key_stable;           // ticks key_last has been the same
+char   key_state;            // debounced scan code, -1 if no key
+char   key_head, key_tail;   // ring buffer indices of key_fifo
+char   key_fifo[KEY_FIFO];   // scan codes of pressed keys
 
 
 /////////////////////////////////////////////////////////////////////////////////
 // !! Current end of global variables, you can add more here.
 /////////////////////////////////////////////////////////////////////////////////
 
-//////////////////////////// Software UART 9600 bit/s /////////////////////////////////////////
+//////////////////////////// Software UART upto 38400 bit/s ///////////////////////////////////
 
-void delay_bit(void)
-{
-  for (glob_j=0; glob_j<glob_b1; glob_j++)
-    continue;
-  glob_d = 0;  // Tune for 9600 Baud
-  glob_d = 0;
-  glob_d = 0;
-  // Note d=d+1  too slow in EPROM (may be ERPOM slower than RAM??)
-  glob_d = 0;
-}
+// Supported bit rates, selected with SHIFT TEST and + / -
+const ulong baud_table[] = {2400, 4800, 9600, 19200, 38400};
+#define NUM_BAUD (sizeof(baud_table)/sizeof(baud_table[0]))
 
 
-void delay_15bit(void)
+// Derive delay counters from the duration of one bit in CPU cycles.
+// Returns 0 if the bit is too short for the software UART.
+int set_bit_time(ulong cycles)
 {
-  for (glob_j=0; glob_j<glob_b2; glob_j++)
-    continue;
-  glob_d=0;
+  if (cycles < UART_OVERHEAD)
+    return 0;
+  glob_b1 = (cycles - UART_OVERHEAD + UART_LOOP/2) / UART_LOOP;
+  glob_b2 = (cycles + cycles/2 - UART_START + UART_LOOP/2) / UART_LOOP;
+  return 1;
 }
 
 
-void send_byte(char n)
+int set_baud(ulong rate)
 {
-  *port1 = 0x7f;  // send start bit
-  delay_bit();
-  for (glob_i=0; glob_i<8; glob_i++) {
-    if (n&1)
-      *port1 = 0xff;
-    else
-      *port1 = 0x7f;
-    delay_bit();
-    n >>= 1;
-  }
-  *port1 = 0xff;   // send stop bit
-  delay_bit();
+  if (!set_bit_time(CPU_CLOCK / rate))
+    return 0;
+  baud_rate = rate;
+  return 1;
 }
 
 
-char get_byte(void)
+// Measure a CR character sent by the terminal and adjust the bit rate.
+// measure_frame returns the time from the start bit to the rising edge
+// before the stop bit, which is 9 bit times for CR.
+int auto_baud(void)
 {
-  glob_n = 0;
+  ulong cycles = measure_frame() * SAMPLE_CYCLES / 9;
+  ulong rate   = CPU_CLOCK / cycles;
+  short j;
 
-  while (*port0&0x80)
-    continue;     // wait for start bit
-  delay_15bit();  // must be 1.5 bit
+  // Snap to a standard rate when within 1/8 of it
+  for (j=0; j<NUM_BAUD; j++)
+    if (rate > baud_table[j] - baud_table[j]/8 &&
+        rate < baud_table[j] + baud_table[j]/8)
+      return set_baud(baud_table[j]);
 
-  for (glob_i=0; glob_i<7; glob_i++) {
-    if ((*port0&0x80)!=0)
-      glob_n |= 0x80;
-    glob_n >>= 1;
-    delay_bit();
-  }
-  delay_bit();   // center bit of D7
-  return glob_n; // rest is for monitor processing half of D7+full period of stop bit
+  if (!set_bit_time(cycles))
+    return 0;
+  baud_rate = rate;
+  return 1;
 }
 
 
@@ -314,165 +486,225 @@ uchar nibble2hex(char c)
 }
 
 
-uchar gethex(void)
+// Let the host send, only when flow control is enabled
+void flow_go(void)
 {
-  char a,b;
-  a = get_byte();
-  b = get_byte();
-  a = nibble2hex(a)<<4;
-  b = nibble2hex(b);
-  a   |= b;
-  bcc += a;  // compute check sum
-  return a;
+  if (flow_control)
+    send_byte(XON);
 }
 
 
-ulong get24bitaddress(void)
+// Stop the host before slow work, call only after complete lines or downloads.
+// Characters the host sends before it sees the XOFF are lost, since we can't
+// receive while sending, so the host still needs a short line delay.
+void flow_stop(void)
 {
-  ulong load_address;
-
-  load_address   = 0;
-  load_address  |= gethex();
-  load_address <<= 8;
-  load_address  |= gethex();
-  load_address <<= 8;
-  load_address  |= gethex();
-
-  return load_address;
+  if (flow_control)
+    send_byte(XOFF);
 }
 
 
-ulong get16bitaddress(void)
+// Receive s-records, c is the first character already received.
+// S1/S2/S3 data records are stored while receiving, S7/S8/S9 end the load
+// and set the PC to their start address if it is not zero.
+void get_s_record(char c)
 {
-  ulong load_address;
-
-  load_address   = 0;
-  load_address  |= gethex();
-  load_address <<= 8;
-  load_address  |= gethex();
-
-  return load_address;
-}
+  ulong stat[SREC_ERR+1+MAX_SREC_ERR];
+  short i;
+  char *p;
 
+  for (i=0; i<=SREC_ERR; i++)
+    stat[i] = 0;
+  stat[SREC_LOW] = 0xffffffff;
 
-void read_record1(void)
-{
-  char i, byte_count;
-  long address24bit;
-  char *sload;
+  load_srec(c, stat);
+  flow_stop();
 
-  bcc = 0;
-  byte_count = gethex()-3;   // byte count only for data byte
-  address24bit = get16bitaddress();
+  if (stat[SREC_ENTRY] && stat[SREC_ERR] == 0)
+    user_pc = save_PC = display_PC = stat[SREC_ENTRY];
 
-  sload = address24bit;
-  for (i=0; i<byte_count; i++)
-    *(sload+i) = gethex();
+  newline();
+  p = format_dec(str2buf(line, "records "), stat[SREC_RECORDS]);
+  p = format_dec(str2buf(p, ", bytes "), stat[SREC_BYTES]);
+  if (stat[SREC_BYTES]) {
+    p = hex2buf(str2buf(p, ", "), stat[SREC_LOW], 5);
+    p = hex2buf(str2buf(p, "-"), stat[SREC_HIGH], 5);
+  }
+  p = hex2buf(str2buf(p, ", entry "), stat[SREC_ENTRY], 5);
+  send_line(p);
+
+  if (stat[SREC_ERR]) {
+    p = format_dec(line, stat[SREC_ERR]);
+    p = str2buf(p, " check sum errors at");
+    for (i=0; i<stat[SREC_ERR] && i<MAX_SREC_ERR; i++)
+      p = hex2buf(str2buf(p, " "), stat[SREC_ERR+1+i], 5);
+    if (stat[SREC_ERR] > MAX_SREC_ERR)
+      p = str2buf(p, " ...");
+    send_line(p);
+  }
+  else
+    pstring("load successfull!\r\n");
 
-  bcc = ~bcc;      // one's complement
-  *gpio1 = bcc;    // loading indicator
+  curr_inst = display_PC;
+  key_data();
+}
 
-  save_bcc = bcc;
 
-  if (save_bcc != gethex())
-    bcc_error = 1;
+// Discard input until the line has been idle for one second
+void purge_input(void)
+{
+  while (get_byte_timeout(TIMEOUT_1S) >= 0)
+    continue;
 }
 
 
-void read_record2(void)
+// Receive XMODEM-CRC (128 byte blocks) or XMODEM-1K (1024 byte blocks)
+// to memory starting at display_PC, c is the first character already received.
+// Data is written to memory while being received, a damaged block is simply
+// overwritten when it is retransmitted after NAK.
+void xmodem_receive(int c)
 {
-  char i, byte_count;
-  long address24bit;
-  char* sload;
+  char   *dest = display_PC;
+  uchar  block = 1;
+  short  errors = 0;
+  ushort size, last_size = 0;
+  int    b, n, crc;
+  char   *data;
 
-  bcc = 0;
-  byte_count = gethex()-4;   // byte count only for data byte
-  address24bit = get24bitaddress();
+  for (;;) {
+    if (c == SOH || c == STX) {
+      size = c == SOH ? 128 : 1024;
+      b = get_byte_timeout(TIMEOUT_1S);
+      n = get_byte_timeout(TIMEOUT_1S);
+
+      if (b >= 0 && n >= 0 && b + n == 0xff &&
+          (b == block || (b == (uchar)(block-1) && last_size))) {
+        // Repeated block when our ACK was lost, receive it again in place.
+        // Block 0 before the first block (YMODEM header) is rejected.
+        data = b == block ? dest : dest - last_size;
+        crc  = receive_block(data, size, TIMEOUT_1S);
+        b    = get_byte_timeout(TIMEOUT_1S);
+        n    = get_byte_timeout(TIMEOUT_1S);
+
+        if (crc >= 0 && b >= 0 && n >= 0 && crc == (b<<8 | n)) {
+          if (data == dest) {
+            dest += size;
+            last_size = size;
+            block++;
+          }
+          *gpio1 = block; // loading indicator
+          errors = 0;
+          send_byte(ACK);
+          c = get_byte_timeout(10*TIMEOUT_1S);
+          continue;
+        }
+      }
+    }
+    else if (c == EOT) {
+      send_byte(ACK);
+      pstring("\r\nload successfull!\r\n");
+      break;
+    }
+    else if (c == CAN) {
+      pstring("\r\ntransfer cancelled!\r\n");
+      break;
+    }
+
+    // Damaged block, timeout or garbage: request retransmission
+    if (++errors > MAX_RETRY) {
+      send_byte(CAN);
+      send_byte(CAN);
+      pstring("\r\ntoo many errors!\r\n");
+      break;
+    }
+    purge_input();
+    send_byte(NAK);
+    c = get_byte_timeout(10*TIMEOUT_1S);
+  }
 
-  sload = address24bit;
+  curr_inst = display_PC;
+  key_data();
+}
 
-  for (i=0; i<byte_count; i++)
-    *(sload+i) = gethex();
 
-  bcc = ~bcc;     // one's complement
-  *gpio1 = bcc;   // loading indicator
+const char hex_digits[] = "0123456789ABCDEF";
 
-  save_bcc = bcc;
+// Append n with digits hex digits to dest, returns pointer behind them
+char *hex2buf(char *dest, ulong n, short digits)
+{
+  char *end = dest + digits;
 
-  if (save_bcc != gethex())
-    bcc_error=1;
+  while (digits--) {
+    dest[digits] = hex_digits[n&0xf];
+    n >>= 4;
+  }
+  return end;
 }
 
 
-void get_s_record(void)
+// Write n as decimal number to dest, returns pointer to terminating 0
+char *format_dec(char *dest, ulong n)
 {
-  char end = 0;
-  bcc_error = 0;
+  char digits[10];
+  short k = 0;
 
-  while (end==0)
-  {
-    while (get_byte() != 'S')
-      continue;
+  do {
+    digits[k++] = '0' + n%10;
+    n /= 10;
+  } while (n);
+  while (k)
+    *dest++ = digits[--k];
+  *dest = 0;
+  return dest;
+}
 
-    switch(get_byte()) // get record type
-    {
-      case '0': end=0; break;
-      case '1': read_record1(); break;
-      case '2': read_record2(); break;
-      case '8': end=1; break;
-      case '9': end=1; break;
-    }
-  }
 
-  if (bcc_error)
-    pstring("\r\ncheck sum errors!\r\n");
-  else
-    pstring("\r\nload successfull!\r\n");
+// Append string to dest, returns pointer to terminating 0
+char *str2buf(char *dest, const char *src)
+{
+  while (*dest = *src++)
+    dest++;
+  return dest;
+}
 
-  curr_inst = display_PC;
-  key_data();
+
+// Send line buffer upto end, followed by newline, as one block
+void send_line(char *end)
+{
+  *end++ = 0x0a;
+  *end++ = 0x0d;
+  write_block(line, end-line);
 }
 
 
 void send_hex(char n)
 {
-  char k;
-  k = n>>4;
-  k = k&0xf;
-
-  if (k>9)
-    send_byte(k+0x37);
-  else
-    send_byte(k+0x30);
-  k = n&0xf;
-  if (k>9)
-    send_byte(k+0x37);
-  else
-    send_byte(k+0x30);
+  char buf[2];
+  write_block(buf, hex2buf(buf, n, 2) - buf);
 }
 
 
 void send_word_hex(ushort n)
 {
-  send_hex((n>>8)&0xff);
-  send_hex(n&0xff);
+  char buf[4];
+  write_block(buf, hex2buf(buf, n, 4) - buf);
 }
 
 
 void send_long_hex(ulong n)
 {
-  send_hex((n>>24)&0xff);
-  send_hex((n>>16)&0xff);
-  send_hex((n>>8)&0xff);
-  send_hex(n&0xff);
+  char buf[8];
+  write_block(buf, hex2buf(buf, n, 8) - buf);
 }
 
 
 // print string to terminal
 void pstring(char *s)
 {
-  while (*s)
-    send_byte(*s++);
+  char *end = s;
+  while (*end)
+    end++;
+  write_block(s, end-s);
 }
 
 
@@ -547,11 +779,37 @@ char scan(void)
 }
 
 
-void delay(int n)
+// Called from service_tick if key_irq is set: refresh the LEDs once and queue
+// debounced key presses for get_key
+void key_tick(void)
 {
-  int u;
-  for (u=0; u<n; u++)
-    continue;
+  char raw = scan();
+  char next;
+
+  if (raw != key_last) {
+    key_last   = raw;
+    key_stable = 1;
+  }
+  else if (key_stable < KEY_STABLE && ++key_stable == KEY_STABLE && raw != key_state) {
+    key_state = raw;
+    next = (key_head + 1) & (KEY_FIFO-1);
+    if (raw >= 0 && raw < 0x24 && next != key_tail) { // drop keys if full
+      key_fifo[key_head] = raw;
+      key_head = next;
+    }
+  }
+}
+
+
+// Non-blocking read of a key queued by key_tick, -1 if none
+int get_key(void)
+{
+  char raw;
+  if (key_tail == key_head)
+    return -1;
+  raw = key_fifo[key_tail];
+  key_tail = (key_tail + 1) & (KEY_FIFO-1);
+  return raw;
 }
 
 
@@ -622,6 +880,7 @@ void key_address(void)
   dot_address();
   entry_started = 0;
   curr_inst = display_PC;
+  inst_anchor = display_PC & -2;
   disassemble_lcd();
   state = STATE_INPUT_ADDR;
 }
@@ -679,12 +938,17 @@ void key_plus(void)
   else if (state==STATE_SHIFT) {
     newline();
   }
+  else if (state==STATE_BAUD) {
+    step_baud(1);
+  }
   else if (state==STATE_INPUT_ADDR ||
            state==STATE_INPUT_DATA ||
            state==STATE_COMP_OFFSET) {
     display_PC++;
-    if (display_PC >= next_inst)
+    if (display_PC >= inst_end()) {
+      cache_inst();
       curr_inst = display_PC;
+    }
     read_memory();
     key_data();
   }
@@ -693,12 +957,14 @@ void key_plus(void)
 
 void key_minus(void)
 {
-  if (state==STATE_INPUT_ADDR ||
+  if (state==STATE_BAUD)
+    step_baud(-1);
+  else if (state==STATE_INPUT_ADDR ||
       state==STATE_INPUT_DATA ||
       state==STATE_COMP_OFFSET) {
     display_PC--;
     if (display_PC < curr_inst)
-      curr_inst = display_PC;
+      curr_inst = find_inst_start();
     read_memory();
     key_data();
   }
@@ -783,6 +1049,7 @@ void key_PC(void)
 {
   display_PC = save_PC;
   curr_inst = display_PC;
+  inst_anchor = display_PC & -2;
   key_data();
 }
 
@@ -829,7 +1096,7 @@ void display_ccr(void)
 
 void display_fmt_sr(void)
 {
-  format_sr();
+  format_sr(line);
   print_led(0,line);
 }
 
@@ -890,7 +1157,7 @@ void insert_byte(void)
 
   dptr[1] = 0;  // insert next byte
   display_PC++;
-  if (display_PC >= next_inst)
+  if (display_PC >= inst_end())
     curr_inst = display_PC;
   read_memory();
   state = STATE_INPUT_DATA;
@@ -1018,10 +1285,12 @@ void find_offset(void)
   ulong delta;
   char  *off8  = start;
   short *off16 = start;
+  ushort inst  = decode_inst(curr_inst & -2, 0);
 
   if (start & 1) {
     // odd address -> use 8 bit offset for Bcc.S, (d8,PC,Xn)
-    if (start-1 == (curr_inst & -2)) {
+    if (start-1 == (curr_inst & -2) && INST_LEN(inst) == 2 &&
+        INST_FLOW(inst) >= FLOW_BRANCH && INST_FLOW(inst) <= FLOW_CALL) {
       // second byte of Bcc.S branch
       delta = destination-start-1;
     }
@@ -1056,12 +1325,20 @@ void key_go(void)
       find_offset();
       break;
 
+    case STATE_BAUD:
+      key_auto_baud();
+      break;
+
+    case STATE_SHIFT:
+      gdb_stub();
+      break;
+
     case STATE_INPUT_ADDR:
     case STATE_INPUT_DATA:
     case STATE_INPUT_REGISTER:
     case STATE_SHOW_REGISTER:
     case STATE_TOGGLE_TRAP1:
-    case STATE_SHIFT:
+    case STATE_CHECKSUM:
       if (breakpoint_at(display_PC))
         step_then_go();
       else
@@ -1106,37 +1383,66 @@ void key_test(void)
 
 void newline(void)
 {
-  send_byte(0x0a);
-  send_byte(0x0d);
+  write_block("\n\r", 2);
 }
 
 
-// Send memory hex dump to terminal
+// Send memory hex dump to terminal, hexdump_width bytes per line in groups of
+// hexdump_group bytes. Like hexdump, lines equal to the previous one are
+// replaced by a single '*' line, only the last line is always shown.
 void dump_memory(void)
 {
-  int j,p;
-  char* dptr = display_PC;
+  char buf[9 + 3*MAX_HEX_WIDTH + 1 + MAX_HEX_WIDTH + 2];
+  uchar *dptr = display_PC;
+  char *dest;
+  short width, group, j, p;
+  char same, skipped = 0;
+
+  group = hexdump_group;
+  if (group != 2 && group != 4)
+    group = 1;
+  width = hexdump_width;
+  if (width < group || width > MAX_HEX_WIDTH)
+    width = 16;
+  width -= width % group;
 
   for (j=0; j<hexdump_lines; j++) {
-    send_long_hex(dptr);
-    send_byte(':');
-    for (p=0; p<16; p++) {
-      send_hex(dptr[p]);
-      send_byte(0x20);
+    same = 0;
+    if (j > 0 && j < hexdump_lines-1) {
+      for (p=0; p<width && dptr[p] == dptr[p-width]; p++)
+        continue;
+      same = p == width;
     }
 
-    send_byte(0x20);
+    if (!same) {
+      dest = hex2buf(buf, dptr, 8);
+      *dest++ = ':';
+      for (p=0; p<width; p++) {
+        *dest++ = hex_digits[dptr[p] >> 4];
+        *dest++ = hex_digits[dptr[p] & 0xf];
+        if ((p & (group-1)) == group-1)
+          *dest++ = ' ';
+      }
+
+      *dest++ = ' ';
 
-    for (p=0; p<16; p++)
-    {
-      char q = dptr[p];
-      if (q >= 0x20 && q < 0x80)
-        send_byte(q); // only printable ASCII
-      else
-        send_byte('.');
+      for (p=0; p<width; p++)
+      {
+        uchar q = dptr[p];
+        if (q >= 0x20 && q < 0x80)
+          *dest++ = q; // only printable ASCII
+        else
+          *dest++ = '.';
+      }
+      *dest++ = 0x0a;
+      *dest++ = 0x0d;
+      write_block(buf, dest-buf);
     }
-    dptr += 16;
-    newline();
+    else if (!skipped)
+      write_block("*\n\r", 3);
+
+    skipped = same;
+    dptr += width;
   }
   display_PC = dptr; // update current display_PC
   key_address();     // update 7-segment as well
@@ -1160,60 +1466,319 @@ void disassemble_lcd()
       line[j] = ' ';
     disassemble(&addr, line);
 
-    // replace TABs by spaces
+    // replace TABs and the end of string by spaces
     for (j=0; j<buf_size; ++j)
-      if (line[j] == 0x09)
+      if (line[j] == 0x09 || line[j] == 0)
         line[j] = ' ';
 
-    clr_screen();
+    // no clr_screen, the lines are padded with spaces and only changed cells are written
     for (k=lines-1; k>=0; --k) {
       line[(k+1) * width] = 0;
       goto_xy(0, k);
       Puts(line + k * width);
     }
+    lcd_flush(); // complete the display before the monitor waits for keys
+  }
+}
+
+
+// Address following the instruction at curr_inst
+ulong inst_end(void)
+{
+  ushort *addr = curr_inst & -2; // clear bit 0
+  return (ulong)addr + INST_LEN(decode_inst(addr, 0));
+}
+
+
+// Remember curr_inst when leaving it with key +
+void cache_inst(void)
+{
+  inst_cache[inst_cache_pos] = curr_inst & -2;
+  inst_cache_pos = (inst_cache_pos + 1) & (INST_CACHE - 1);
+}
+
 
-    next_inst = addr;
+// Start of the instruction containing display_PC when going back with key -.
+// Try instructions left with key + first, then decode forward from the last
+// address entered or the user PC, whichever is closer.
+ulong find_inst_start(void)
+{
+  char  j;
+  ulong addr = display_PC & -2;
+  ulong p, next;
+
+  for (j=0; j<INST_CACHE; j++) {
+    p = inst_cache[j];
+    if (p && p <= addr && display_PC < p + INST_LEN(decode_inst(p, 0)))
+      return p;
+  }
+
+  p = inst_anchor;
+  if (p > addr || (user_pc & -2) <= addr && (user_pc & -2) > p)
+    p = user_pc & -2;
+  if (p <= addr && addr - p <= MAX_RESYNC) {
+    for (;;) {
+      next = p + INST_LEN(decode_inst(p, 0));
+      if (next > display_PC)
+        return p;
+      p = next;
+    }
   }
+  return display_PC;
 }
 
 
 // Send disassembly listing to terminal
 void disassemble_list(void)
 {
-  char j;
+  char  j;
+  ulong total = 0;
 
   for (j=0; j<disasm_lines; ++j) {
-    display_PC = dump_disassembly(display_PC);
+    display_PC = dump_disassembly(display_PC, &total);
   }
   key_address(); // update 7-segment as well
 }
 
 
-// Send one line of disassembly to terminal
-ushort* dump_disassembly(ushort* addr)
+// 68000 times n(r) of effective address calculation for byte and word operands,
+// Dn, An, (An), (An)+, -(An), (d16,An), (d8,An,Xn), abs.W, abs.L, (d16,PC), (d8,PC,Xn), #imm
+const uchar ea_time[]  = {0, 0, 4, 4, 6, 8, 10, 8, 12, 8, 10, 4};
+const uchar ea_reads[] = {0, 0, 1, 1, 1, 2,  2, 2,  3, 2,  2, 1};
+
+// 68008 times of JMP and JSR for (An) upto #imm, 8 for invalid modes
+const uchar jmp_time[] = {16, 8, 8, 18, 26, 18, 24, 18, 26, 8};
+const uchar jsr_time[] = {32, 8, 8, 34, 38, 34, 40, 34, 38, 8};
+
+
+// Index into ea_time for effective address in bits 5..0
+int ea_index(int ea)
+{
+  int reg = ea & 7;
+  ea = (ea >> 3) & 7;
+  return ea < 7 ? ea : 7 + (reg > 4 ? 4 : reg);
+}
+
+
+// 68008 cycles to compute an effective address and read a byte, word or long
+// operand from it. The 8 bit bus takes 4 cycles per byte, so each 68000 word
+// access costs 4 cycles more.
+int ea_cycles(int ea, int size)
+{
+  int i = ea_index(ea);
+  int n = ea_time[i] + 4 * ea_reads[i];
+
+  if (i < 2)
+    return 0;
+  if (size == 4)
+    n += 8;
+  else if (size == 1 && i != 11)
+    n -= 4; // single byte access
+  return n;
+}
+
+
+// 68008 cycles to fetch the extension words of an effective address without
+// reading the operand, indexed modes add idx
+int ea_addr_cycles(int ea, int idx)
+{
+  int i = ea_index(ea);
+  return i < 2 ? 0 : 8 * (ea_reads[i] - 1) + (i == 6 || i == 10 ? idx : 0);
+}
+
+
+// Estimated 68008 cycles of the instruction at addr, from the 68000 timing
+// tables with 4 cycles per byte on the bus. Branches are counted as taken,
+// MUL and DIV with their maximum, shifts by a register count as 0 bits.
+int inst_cycles(ushort* addr)
+{
+  ushort op   = *addr;
+  int    ea   = op & 0x3f;
+  int    mem  = ea >= 0x10;           // operand in memory, not Dn or An
+  int    size = 1 << ((op >> 6) & 3); // 1, 2, 4 or 8 for special forms
+  int    type = (op >> 6) & 3;        // BTST, BCHG, BCLR, BSET
+  int    dst, n;
+  ushort mask;
+
+  if (INST_FLOW(decode_inst(addr, 0)) == FLOW_EXCEPT)
+    return 62; // exception processing
+
+  switch (op >> 12) {
+    case 0x0:
+      if ((op & 0x0138) == 0x0108)  // MOVEP
+        return op & 0x40 ? 32 : 24;
+      if (op & 0x0100 || (op & 0x0e00) == 0x0800) {
+        n = op & 0x0100 ? 8 : 16;   // BTST ... Dn,<ea> or #<data>,<ea>
+        if (mem)
+          return n + ea_cycles(ea, 1) + (type ? 4 : 0);
+        return n + (type == 0 ? 2 : (type == 2 ? 6 : 4));
+      }
+      if (ea == 0x3c)               // ORI, ANDI, EORI to CCR or SR
+        return 32;
+      n = 8 + (size == 4 ? 16 : 8); // ORI ... CMPI #<data>,<ea>
+      if ((op & 0x0e00) == 0x0c00)
+        return n + (mem ? ea_cycles(ea, size) : (size == 4 ? 2 : 0));
+      return n + (mem ? ea_cycles(ea, size) + 4 * size : (size == 4 ? 4 : 0));
+
+    case 0x1:
+    case 0x2:
+    case 0x3:                       // MOVE, MOVEA
+      size = (op & 0x3000) == 0x1000 ? 1 : ((op & 0x3000) == 0x2000 ? 4 : 2);
+      n = 8 + ea_cycles(ea, size);
+      dst = (op >> 9 & 7) | (op >> 3 & 0x38);
+      if (dst >= 0x10)
+        n += ea_addr_cycles(dst, 2) + 4 * size;
+      return n;
+
+    case 0x4:
+      if ((op & 0xfff0) == 0x4e40)  // TRAP
+        return 62;
+      switch (op & 0xfff8) {
+        case 0x4e50: return 32;     // LINK
+        case 0x4e58: return 24;     // UNLK
+        case 0x4e60:
+        case 0x4e68: return 8;      // MOVE USP
+      }
+      switch (op) {
+        case 0x4e70: return 136;    // RESET
+        case 0x4e72: return 16;     // STOP
+        case 0x4e73:
+        case 0x4e77: return 40;     // RTE, RTR
+        case 0x4e75: return 32;     // RTS
+        case 0x4e71:
+        case 0x4e76: return 8;      // NOP, TRAPV
+      }
+      switch (op & 0xffc0) {
+        case 0x4e80: return mem ? jsr_time[ea_index(ea) - 2] : 8; // JSR
+        case 0x4ec0: return mem ? jmp_time[ea_index(ea) - 2] : 8; // JMP
+        case 0x4840: return mem ? 24 + ea_addr_cycles(ea, 4) : 8; // PEA, SWAP
+        case 0x40c0: return mem ? 16 + ea_cycles(ea, 2) : 10;     // MOVE from SR
+        case 0x44c0:
+        case 0x46c0: return 16 + ea_cycles(ea, 2);                // MOVE to CCR, SR
+        case 0x4800: return mem ? 12 + ea_cycles(ea, 1) : 10;     // NBCD
+        case 0x4ac0: return mem ? 14 + ea_cycles(ea, 1) : 8;      // TAS
+      }
+      if ((op & 0xfb80) == 0x4880) { // MOVEM, EXT
+        if (!(op & 0x0438))
+          return 8;
+        for (n=0, mask=addr[1]; mask; mask >>= 1)
+          n += mask & 1;
+        n *= op & 0x40 ? 16 : 8;
+        return n + (op & 0x0400 ? 24 : 16) + ea_addr_cycles(ea, 2);
+      }
+      if ((op & 0x01c0) == 0x01c0)  // LEA
+        return 8 + ea_addr_cycles(ea, 4);
+      if ((op & 0x01c0) == 0x0180)  // CHK
+        return 14 + ea_cycles(ea, 2);
+      if ((op & 0xff00) == 0x4a00)  // TST
+        return 8 + ea_cycles(ea, size);
+      // CLR, NEG, NEGX, NOT
+      return mem ? 8 + ea_cycles(ea, size) + 4 * size : (size == 4 ? 10 : 8);
+
+    case 0x5:
+      if ((op & 0xf0f8) == 0x50c8)  // DBcc
+        return 18;
+      if (size == 8)                // Scc
+        return mem ? 12 + ea_cycles(ea, 1) : 10;
+      if (!mem)                     // ADDQ, SUBQ
+        return ea >= 8 || size == 4 ? 12 : 8;
+      return 8 + ea_cycles(ea, size) + 4 * size;
+
+    case 0x6:                       // Bcc, BRA, BSR
+      return (op & 0xff00) == 0x6100 ? 34 : 18;
+
+    case 0x7:                       // MOVEQ
+      return 8;
+
+    case 0x8:
+    case 0xc:
+      if (size == 8) {              // DIVU, DIVS, MULU, MULS
+        n = op & 0x4000 ? 74 : (op & 0x0100 ? 162 : 144);
+        return n + ea_cycles(ea, 2);
+      }
+      if ((op & 0x01f0) == 0x0100)  // SBCD, ABCD
+        return op & 0x08 ? 22 : 10;
+      if ((op & 0xf130) == 0xc100)  // EXG
+        return 10;
+      break;
+
+    case 0x9:
+    case 0xb:
+    case 0xd:
+      if (size == 8) {              // SUBA, CMPA, ADDA
+        size = op & 0x0100 ? 4 : 2;
+        n = 10 + ea_cycles(ea, size);
+        if ((op & 0xf000) == 0xb000)
+          return n;
+        return n + (size == 2 || ea < 0x10 || ea == 0x3c ? 2 : 0);
+      }
+      if ((op & 0xf138) == 0xb108)  // CMPM
+        return size == 1 ? 16 : (size == 2 ? 24 : 40);
+      if ((op & 0xb130) == 0x9100)  // SUBX, ADDX
+        return op & 0x08 ? (size == 1 ? 22 : (size == 2 ? 34 : 58)) : (size == 4 ? 12 : 8);
+      if ((op & 0xf100) == 0xb000)  // CMP
+        return 8 + ea_cycles(ea, size) + (size == 4 ? 2 : 0);
+      break;
+
+    case 0xe:
+      if (size == 8)                // memory shift
+        return 16 + ea_cycles(ea, 2);
+      n = op & 0x20 ? 0 : ((op >> 9) & 7 ? (op >> 9) & 7 : 8);
+      return 10 + (size == 4 ? 2 : 0) + 2 * n;
+  }
+
+  // OR, SUB, EOR, AND, ADD
+  if (op & 0x0100 && mem)           // Dn,<ea>
+    return 8 + ea_cycles(ea, size) + 4 * size;
+  if (op & 0x0100)                  // EOR Dn,Dn
+    return size == 4 ? 12 : 8;
+  return 8 + ea_cycles(ea, size) + (size == 4 ? (ea < 0x10 || ea == 0x3c ? 4 : 2) : 0);
+}
+
+
+// Send one line of disassembly to terminal, with cycles and their running
+// total if total isn't 0
+ushort* dump_disassembly(ushort* addr, ulong* total)
 {
   ushort *laddr;
   char  j;
+  char  *dest, *src;
+  char  inst[80];
+  int   cycles;
 
   laddr = addr &= -2; // start at even address;
-  send_long_hex(addr);
-  send_byte(':');
-  send_byte(breakpoint_at(laddr) ? '*' : ' ');
-  disassemble(&addr, line);
+  dest = hex2buf(line, addr, 8);
+  *dest++ = ':';
+  *dest++ = breakpoint_at(laddr) ? '*' : ' ';
+  disassemble(&addr, inst);
+
+  if (disasm_cycles) {
+    // Append cycles to the comment field
+    cycles = inst_cycles(laddr);
+    for (src=inst, j=0; *src; src++)
+      if (*src == ';')
+        j = 1;
+    src = format_dec(str2buf(src, j ? ", " : "\t; "), cycles);
+    if (total) {
+      *total += cycles;
+      src = format_dec(str2buf(src, " / "), *total);
+    }
+  }
 
   // Print upto 5 code words
   for (j=0; j<5; ++j) {
     if (laddr < addr)
-      send_word_hex(*laddr++);
+      dest = hex2buf(dest, *laddr++, 4);
     else
-      pstring("    ");
-    send_byte(' ');
+      dest = str2buf(dest, "    ");
+    *dest++ = ' ';
   }
-  pstring("  ");
+  dest = str2buf(dest, "  ");
 
-  // Print assembler instruction
-  pstring(line);
-  newline();
+  // Print assembler instruction, leaving space for newline
+  for (src=inst; *src && dest<line+sizeof(line)-2; )
+    *dest++ = *src++;
+  send_line(dest);
 
   return addr;
 }
@@ -1223,47 +1788,46 @@ ushort* dump_disassembly(ushort* addr)
 void dump_registers(void)
 {
   char j;
+  char *dest;
 
   // First line: print 8 data registers
-  pstring("D0:");
+  dest = str2buf(line, "D0:");
   for (j=0; j<8; j++) {
-    send_byte(' ');
-    send_long_hex(user_data[j]);
+    *dest++ = ' ';
+    dest = hex2buf(dest, user_data[j], 8);
   }
-  newline();
+  send_line(dest);
 
   // Second line: print 7 address registers, USP or SSP depending on mode
-  pstring("A0:");
+  dest = str2buf(line, "A0:");
   for (j=0; j<7; j++) {
-    send_byte(' ');
-    send_long_hex(user_addr[j]);
+    *dest++ = ' ';
+    dest = hex2buf(dest, user_addr[j], 8);
   }
-  send_byte(' ');
-  if (user_sr & 0x2000)
-    send_long_hex(user_ssp);
-  else
-    send_long_hex(user_usp);
-  newline();
+  *dest++ = ' ';
+  dest = hex2buf(dest, user_sr & 0x2000 ? user_ssp : user_usp, 8);
+  send_line(dest);
 
   // Third line: print status register, formatted, and both stack pointers
-  pstring("SR: ");
-  send_word_hex(user_sr);
-  pstring("     ");
-  format_sr();
-  pstring(line);
-  pstring("     USP: "); send_long_hex(user_usp);
-  pstring("     SSP: "); send_long_hex(user_ssp);
-  newline();
+  dest = str2buf(line, "SR: ");
+  dest = hex2buf(dest, user_sr, 4);
+  dest = str2buf(dest, "     ");
+  dest = format_sr(dest);
+  dest = str2buf(dest, "     USP: ");
+  dest = hex2buf(dest, user_usp, 8);
+  dest = str2buf(dest, "     SSP: ");
+  dest = hex2buf(dest, user_ssp, 8);
+  send_line(dest);
 
   // Fourth line: print next assembler instruction
-  dump_disassembly(display_PC);
+  dump_disassembly(display_PC, 0);
   key_address();     // update 7-segment as well
 }
 
 
-void format_sr(void)
+// Write status register symbolically to dest, returns pointer to terminating 0
+char *format_sr(char *dest)
 {
-  char *dest = line;
   *dest++ = user_sr & 0x8000 ? 'T' : '-';
   *dest++ = user_sr & 0x2000 ? 'S' : '-';
   *dest++ = ((user_sr & 0x0700) >> 8) + '0'; // Interrupt level
@@ -1273,13 +1837,202 @@ void format_sr(void)
   *dest++ = user_sr & 0x0002 ? 'V' : '-';
   *dest++ = user_sr & 0x0001 ? 'C' : '-';
   *dest   = 0;
+  return dest;
+}
+
+
+// Receive a byte with timeout and add it to the header check sum.
+// Returns -1 on timeout.
+int get_header_byte(void)
+{
+  int c = get_byte_timeout(TIMEOUT_1S);
+  bcc += c;
+  return c;
+}
+
+
+// Receive compressed image, produced by makelz.py, after the leading 'Z':
+//   3 bytes load address, 3 bytes length, 1 byte header check sum,
+//   LZSS stream (see receive_lz), 2 bytes CRC-16 of LZSS stream
+void lz_receive(void)
+{
+  ulong address = 0, length = 0;
+  int   j, c, crc;
+
+  bcc = 0;
+  for (j=0; j<3; j++)
+    address = address<<8 | get_header_byte() & 0xff;
+  for (j=0; j<3; j++)
+    length  = length<<8  | get_header_byte() & 0xff;
+  c = get_byte_timeout(TIMEOUT_1S);
+
+  if (c < 0 || (uchar)~bcc != c)
+    pstring("\r\nheader error!\r\n");
+  else {
+    crc = receive_lz(address, length, TIMEOUT_1S);
+    c   = get_byte_timeout(TIMEOUT_1S);
+    j   = get_byte_timeout(TIMEOUT_1S);
+    flow_stop();
+
+    if (crc < 0 || c < 0 || j < 0)
+      pstring("\r\ntimeout!\r\n");
+    else if (crc != (c<<8 | j))
+      pstring("\r\ncheck sum errors!\r\n");
+    else {
+      pstring("\r\nload successfull!\r\n");
+      display_PC = address;
+    }
+  }
+
+  curr_inst = display_PC;
+  key_data();
 }
 
 
+// Wait for the first character of a download. Poll for XMODEM-CRC with 'C'
+// every 3 seconds, s-records are recognized by their leading 'S' and
+// compressed images by their leading 'Z'.
 void load_srecord(void)
 {
-  pstring("\r\nLoad Motorola s-record: ");
-  get_s_record();  // could be S1 (16-bit load address) or S2 (24-bit load address)
+  int c;
+
+  pstring("\r\nLoad Motorola s-record or XMODEM: ");
+  flow_go();
+  while ((c = get_byte_timeout(3*TIMEOUT_1S)) < 0)
+    send_byte('C');
+
+  if (c == SOH || c == STX)
+    xmodem_receive(c);
+  else if (c == 'Z')
+    lz_receive();
+  else
+    get_s_record(c);  // S1, S2 or S3 records
+}
+
+
+// Common end of saving memory, back to the start of the range
+void save_done(void)
+{
+  display_PC = start;
+  read_memory();
+  dot_data();
+  state = STATE_INPUT_DATA;
+}
+
+
+// Save memory from start upto the current address (exclusive) to the
+// terminal as S2 records with an S8 end record
+void save_srecords(void)
+{
+  uchar *dptr = start;
+  uchar sum;
+  short n, k;
+  char *p;
+
+  end = display_PC;
+  if (end <= start) {
+    print_error();
+    return;
+  }
+
+  newline();
+  while ((ulong)dptr < end) {
+    n = end-(ulong)dptr > SAVE_SREC_BYTES ? SAVE_SREC_BYTES : end-(ulong)dptr;
+    sum = n+4 + ((ulong)dptr>>16) + ((ulong)dptr>>8) + (ulong)dptr;
+    p = hex2buf(str2buf(line, "S2"), n+4, 2);
+    p = hex2buf(p, dptr, 6);
+    for (k=0; k<n; k++) {
+      *p++ = hex_digits[dptr[k] >> 4];
+      *p++ = hex_digits[dptr[k] & 0xf];
+      sum += dptr[k];
+    }
+    dptr += n;
+    send_line(hex2buf(p, (uchar)~sum, 2));
+  }
+  write_block("S804000000FB\n\r", 14);
+  save_done();
+}
+
+
+// Save memory from start upto the current address (exclusive) to the
+// terminal in base64, framed by a header with address and length
+// and a trailer with the CRC-16 of the data
+void save_base64(void)
+{
+  static const char b64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  uchar *dptr = start;
+  ulong len, v;
+  short n, k;
+  char *p;
+
+  end = display_PC;
+  if (end <= start) {
+    print_error();
+    return;
+  }
+
+  newline();
+  len = end-start;
+  p = hex2buf(str2buf(line, "B64 "), start, 5);
+  send_line(format_dec(str2buf(p, " "), len));
+
+  while (len) {
+    n = len > SAVE_B64_BYTES ? SAVE_B64_BYTES : len;
+    p = line;
+    for (k=0; k<n; k+=3) {
+      v = (ulong)dptr[k] << 16;
+      if (k+1 < n)
+        v |= (ulong)dptr[k+1] << 8;
+      if (k+2 < n)
+        v |= dptr[k+2];
+      *p++ = b64[v>>18 & 0x3f];
+      *p++ = b64[v>>12 & 0x3f];
+      *p++ = k+1 < n ? b64[v>>6 & 0x3f] : '=';
+      *p++ = k+2 < n ? b64[v & 0x3f] : '=';
+    }
+    dptr += n;
+    len -= n;
+    send_line(p);
+  }
+
+  send_line(hex2buf(str2buf(line, "CRC "), crc16(start, end-start, 0), 4));
+  save_done();
+}
+
+
+// Show CRC-32 of memory from start upto the current address (exclusive)
+// on LED and terminal. Pressing TEST again shows the Fletcher-16 check sum
+// of the same range.
+void range_checksum(void)
+{
+  char digits[10];
+  char *p;
+
+  if (state == STATE_COPY_END) {
+    end = display_PC;
+    if (end <= start) {
+      print_error();
+      return;
+    }
+  }
+
+  p = hex2buf(line, start, 5);
+  p = hex2buf(str2buf(p, "-"), end-1, 5);
+  if (state == STATE_COPY_END) {
+    *hex2buf(digits, crc32(start, end-start, 0), 8) = 0;
+    print_led(0, digits);
+    p = str2buf(p, " CRC32 ");
+  }
+  else {
+    *hex2buf(digits, fletcher16(start, end-start), 4) = 0;
+    print_led(0, "FL  ");
+    print_led(4, digits);
+    p = str2buf(p, " Fletcher16 ");
+  }
+  newline();
+  send_line(str2buf(p, digits));
+  state = STATE_CHECKSUM;
 }
 
 
@@ -1292,6 +2045,142 @@ void toggle_trap1(void)
 }
 
 
+// Show current bit rate on LED, right aligned
+void display_baud(void)
+{
+  char digits[12];
+  short k = format_dec(digits, baud_rate) - digits;
+  print_led(0,"bd      ");
+  print_led(8-k,digits);
+}
+
+
+// Confirm new bit rate on the terminal
+void announce_baud(void)
+{
+  char digits[12];
+  format_dec(digits, baud_rate);
+  pstring("\r\nbit rate ");
+  pstring(digits);
+  newline();
+}
+
+
+// SHIFT TEST: select bit rate with + and -, GO for auto-baud
+void select_baud(void)
+{
+  display_baud();
+  state = STATE_BAUD;
+}
+
+
+void step_baud(short dir)
+{
+  short j;
+
+  for (j=0; j<NUM_BAUD && baud_table[j]<baud_rate; j++)
+    continue;
+  if (dir > 0) {
+    if (j<NUM_BAUD && baud_table[j]==baud_rate)
+      j++;
+  }
+  else
+    j--;
+
+  if (j>=0 && j<NUM_BAUD) {
+    if (set_baud(baud_table[j])) {
+      display_baud();
+      announce_baud();
+    }
+    else
+      print_error(); // too fast for software UART
+  }
+}
+
+
+void key_auto_baud(void)
+{
+  print_led(0,"bd Auto ");
+  pstring("\r\nPress ENTER at new bit rate");
+  if (auto_baud()) {
+    display_baud();
+    announce_baud();
+  }
+  else
+    print_error();
+}
+
+
+// Prefilter for the trace handler, which only searches break_points if the bit is set
+void set_bp_filter(ulong address)
+{
+  short n = (address >> 1) & (BP_FILTER-1);
+  bp_filter[n >> 5] |= 1L << (n & 31);
+}
+
+
+void build_bp_filter(void)
+{
+  short j;
+  for (j=0; j<BP_FILTER/32; j++)
+    bp_filter[j] = 0;
+  for (j=0; j<num_bp; j++)
+    set_bp_filter(break_points[j]);
+}
+
+
+// Index of the first breakpoint at or above address
+short find_breakpoint(ulong address)
+{
+  short lo = 0, hi = num_bp, mid;
+  while (lo < hi) {
+    mid = (lo + hi) >> 1;
+    if (break_points[mid] < address)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+
+// Index of the condition of the breakpoint at address, -1 if none
+short find_condition(ulong address)
+{
+  short j;
+  for (j=0; j<MAX_COND; j++)
+    if (cond_addr[j] == address)
+      return j;
+  return -1;
+}
+
+
+void clear_condition(ulong address)
+{
+  short j = find_condition(address);
+  if (j >= 0)
+    cond_addr[j] = NO_COND;
+}
+
+
+// Set or replace the condition of the breakpoint at address, returns 0 if the table is full.
+// The trace and TRAP #3 handlers evaluate it in bp_condition in services.asm.
+int set_condition(ulong address, ulong src, ushort op, ulong value, ulong mask)
+{
+  short j = find_condition(address);
+  if (j < 0)
+    j = find_condition(NO_COND);
+  if (j < 0)
+    return 0;
+  cond_src[j]   = src;
+  cond_op[j]    = op;
+  cond_value[j] = value;
+  cond_mask[j]  = mask;
+  cond_addr[j]  = address;
+  return 1;
+}
+
+
 void toggle_breakpoint(ulong address)
 {
   short j,k;
@@ -1299,41 +2188,171 @@ void toggle_breakpoint(ulong address)
   if (address & 1)
     return;
 
-  for (j=0; j<num_bp; j++) {
-    if (address == break_points[j]) {
-      // breakpoint exists at address, delete it
-      for (k=j; k<num_bp-1; k++)
-        // slide down breakpoints above
-        break_points[k] = break_points[k+1];
-      num_bp--;
-      return;
+  j = find_breakpoint(address);
+  if (j < num_bp && address == break_points[j]) {
+    // breakpoint exists at address, delete it
+    for (k=j; k<num_bp-1; k++) {
+      // slide down breakpoints above
+      break_points[k] = break_points[k+1];
+      bp_hits[k]      = bp_hits[k+1];
+      bp_ignore[k]    = bp_ignore[k+1];
     }
-    else if (address < break_points[j]) {
-      // insert new breakpoint here
-      if (num_bp < MAX_BP) {
-        for (k=num_bp; k>j; k--)
-          // slide up breakpoints above
-          break_points[k] = break_points[k-1];
-        break_points[j] = address;
-        num_bp++;
-        return;
-      }
-      else
-        // no space for breakpoint
-        return;
+    num_bp--;
+    build_bp_filter();
+    clear_condition(address);
+  }
+  else if (num_bp < MAX_BP) {
+    // insert new breakpoint here, slide up breakpoints above
+    for (k=num_bp; k>j; k--) {
+      break_points[k] = break_points[k-1];
+      bp_hits[k]      = bp_hits[k-1];
+      bp_ignore[k]    = bp_ignore[k-1];
     }
-    // else next
+    break_points[j] = address;
+    bp_hits[j] = bp_ignore[j] = 0;
+    num_bp++;
+    set_bp_filter(address);
   }
-  if (num_bp < MAX_BP)
-    // insert new breakpoint above all previous ones
-    break_points[num_bp++] = address;
+  // else no space for breakpoint
 }
 
 
 void clear_all_breakpoints(void)
 {
+  short j;
   num_bp = 0;
   bp_armed = 0;
+  build_bp_filter();
+  for (j=0; j<MAX_COND; j++)
+    cond_addr[j] = NO_COND;
+}
+
+
+// Send condition of breakpoint at address to terminal, if there is one
+void dump_condition(ulong address)
+{
+  static const char ops[] = "=!<>";
+  short j = find_condition(address);
+  ushort size;
+  char *dest;
+
+  if (j < 0)
+    return;
+  size = cond_op[j] & 0xff00;
+  dest = str2buf(line, ";   if ");
+  if (size == COND_REG) {
+    *dest++ = cond_src[j] < 8 ? 'D' : 'A';
+    *dest++ = '0' + (cond_src[j] & 7);
+  }
+  else {
+    dest = hex2buf(dest, cond_src[j], 5);
+    dest = str2buf(dest, size == COND_B ? ".B" : size == COND_W ? ".W" : ".L");
+  }
+  *dest++ = ' ';
+  *dest++ = ops[(cond_op[j] & 0xff) - 1];
+  *dest++ = ' ';
+  dest = hex2buf(dest, cond_value[j], 8);
+  if (cond_mask[j] != 0xffffffffL) {
+    dest = str2buf(dest, " mask ");
+    dest = hex2buf(dest, cond_mask[j], 8);
+  }
+  send_line(dest);
+}
+
+
+// Current value of watchpoint j
+ulong watch_value(short j)
+{
+  switch (watch_mode[j] >> 8) {
+    case 1: return *(uchar *)watch_addr[j];
+    case 2: return *(ushort *)watch_addr[j];
+  }
+  return *(ulong *)watch_addr[j];
+}
+
+
+// Remove the watchpoint at address with size, or add it, stopping at any change or
+// when the value changes to target. Returns 0 on error.
+int toggle_watch(ulong address, short size, short eq, ulong target)
+{
+  short j;
+
+  if (size != 1 && (address & 1))
+    return 0;
+  for (j=0; j<num_watch && (watch_addr[j] != address || watch_mode[j] >> 8 != size); j++)
+    continue;
+  if (j < num_watch && !eq) {
+    // remove it, slide down watchpoints above
+    for (num_watch--; j<num_watch; j++) {
+      watch_addr[j]   = watch_addr[j+1];
+      watch_old[j]    = watch_old[j+1];
+      watch_target[j] = watch_target[j+1];
+      watch_mode[j]   = watch_mode[j+1];
+    }
+    return 1;
+  }
+  if (j == MAX_WATCH)
+    return 0;
+  watch_addr[j]   = address;
+  watch_mode[j]   = size << 8 | (eq ? WATCH_EQ : 0);
+  watch_target[j] = target;
+  watch_old[j]    = watch_value(j);
+  if (j == num_watch)
+    num_watch++;
+  return 1;
+}
+
+
+// Append address and size of watchpoint j to dest
+char *watch2buf(char *dest, short j)
+{
+  short size = watch_mode[j] >> 8;
+  dest = hex2buf(dest, watch_addr[j], 5);
+  return str2buf(dest, size == 1 ? ".B " : size == 2 ? ".W " : ".L ");
+}
+
+
+// Send all watchpoints with their values to terminal
+void dump_watchpoints(void)
+{
+  short j;
+  char *dest;
+
+  dest = str2buf(line, "; ");
+  dest = format_dec(dest, num_watch);
+  dest = str2buf(dest, num_watch != 1 ? " watchpoints set" : " watchpoint set");
+  send_line(dest);
+  for (j=0; j<num_watch; j++) {
+    dest = watch2buf(str2buf(line, "; "), j);
+    dest = hex2buf(dest, watch_value(j), 2 * (watch_mode[j] >> 8));
+    if (watch_mode[j] & WATCH_EQ) {
+      dest = str2buf(dest, ", stop at ");
+      dest = hex2buf(dest, watch_target[j], 2 * (watch_mode[j] >> 8));
+    }
+    send_line(dest);
+  }
+}
+
+
+// Called from the trace handler when a watchpoint triggered: report the
+// changed values and remember them
+void watch_stop(void)
+{
+  short j;
+  ulong value;
+  char *dest;
+
+  for (j=0; j<num_watch; j++) {
+    value = watch_value(j);
+    if (value != watch_old[j]) {
+      dest = watch2buf(str2buf(line, "; watch "), j);
+      dest = hex2buf(dest, watch_old[j], 2 * (watch_mode[j] >> 8));
+      dest = str2buf(dest, " -> ");
+      dest = hex2buf(dest, value, 2 * (watch_mode[j] >> 8));
+      send_line(dest);
+      watch_old[j] = value;
+    }
+  }
 }
 
 
@@ -1341,15 +2360,22 @@ void clear_all_breakpoints(void)
 void dump_breakpoints(void)
 {
   short j;
-  pstring("; ");
-  send_byte('0' + num_bp);
-  pstring(" breakpoint");
-  if (num_bp != 1)
-    send_byte('s');
-  pstring(" set");
-  newline();
+  char *dest;
+
+  dest = str2buf(line, "; ");
+  dest = format_dec(dest, num_bp);
+  dest = str2buf(dest, num_bp != 1 ? " breakpoints set" : " breakpoint set");
+  send_line(dest);
   for (j=0; j<num_bp; j++) {
-    dump_disassembly(break_points[j]);
+    dump_disassembly(break_points[j], 0);
+    dump_condition(break_points[j]);
+    if (bp_hits[j] || bp_ignore[j]) {
+      dest = str2buf(line, ";   hits ");
+      dest = format_dec(dest, bp_hits[j]);
+      dest = str2buf(dest, ", ignore ");
+      dest = format_dec(dest, bp_ignore[j]);
+      send_line(dest);
+    }
   }
   key_address();
 }
@@ -1357,17 +2383,28 @@ void dump_breakpoints(void)
 
 int breakpoint_at(ulong address)
 {
-  short j;
-  for (j=0; j<num_bp; j++)
-    if (break_points[j]==address)
-      return 1;
-  return 0;
+  short j = find_breakpoint(address);
+  return j < num_bp && break_points[j] == address;
+}
+
+
+// Continue after the next count hits of the breakpoint at address and clear its
+// hit counter, returns 0 if there is no breakpoint
+int set_ignore(ulong address, ulong count)
+{
+  short j = find_breakpoint(address);
+  if (j >= num_bp || break_points[j] != address)
+    return 0;
+  bp_hits[j]   = 0;
+  bp_ignore[j] = count > 0xffff ? 0xffff : count;
+  return 1;
 }
 
 
 void key_user(void)
 {
-  char* pc = (char*)display_PC;
+  ushort inst;
+  ulong  vector = 0;
 
   if (state==STATE_SHIFT) {
     if ((user_sr & 0x2000)  && user_ssp >= INIT_SSP ||
@@ -1380,9 +2417,10 @@ void key_user(void)
       step_out();
   }
   else {
-    if (pc[0] == 0x4e && (pc[1] == 0x40 || pc[1] == 0x41)) {
+    inst = (display_PC & 1) ? 0 : decode_inst(display_PC, &vector);
+    if (INST_FLOW(inst) == FLOW_TRAP && (vector == 0x80 || vector == 0x84)) {
       // TRAP #0 or TRAP #1, always skip over these
-      display_PC += 2;
+      display_PC += INST_LEN(inst);
       key_address();
     }
     else
@@ -1492,18 +2530,28 @@ void key_exe(void)
         break;
 
       case 0x14: // Key TEST
-        key_test();
+        if (state==STATE_SHIFT)
+          select_baud();
+        else if (state==STATE_COPY_END ||
+                 state==STATE_CHECKSUM)
+          range_checksum();
+        else
+          key_test();
         break;
 
       case 0x1e: // Key DUMP
-        if (state==STATE_SHIFT)
+        if (state==STATE_COPY_END)
+          save_srecords();
+        else if (state==STATE_SHIFT)
           dump_registers();
         else
           dump_memory();
         break;
 
       case 0x1d: // Key LOAD
-        if (state==STATE_SHIFT)
+        if (state==STATE_COPY_END)
+          save_base64();
+        else if (state==STATE_SHIFT)
           dump_breakpoints();
         else
           load_srecord();
@@ -1571,18 +2619,538 @@ char code2internal(char n)
 */
 
 
+////////////////////////////// Terminal command line ////////////////////////////////
+
+char *skip_blanks(char *p)
+{
+  while (*p == ' ')
+    p++;
+  return p;
+}
+
+
+// Parse hex number at p, returns pointer behind it or 0 if there is none
+char *parse_hex(char *p, ulong *n)
+{
+  char *q;
+  char c;
+
+  p = skip_blanks(p);
+  *n = 0;
+  for (q=p; ; q++) {
+    c = *q | 0x20; // lower case
+    if (c >= '0' && c <= '9')
+      c -= '0';
+    else if (c >= 'a' && c <= 'f')
+      c -= 'a'-10;
+    else
+      break;
+    *n = *n<<4 | c;
+  }
+  return q==p ? 0 : q;
+}
+
+
+// Set register named at p (d0-d7, a0-a6, usp, ssp, sr, pc) to the following
+// hex value, returns 0 on error
+int set_register(char *p)
+{
+  static const char *const names[] = {"usp", "ssp", "sr", "pc"};
+  char  c, n;
+  short j, k;
+  ulong value;
+
+  p = skip_blanks(p);
+  c = p[0] | 0x20;
+  n = p[1] - '0';
+  if ((c=='d' && n>=0 && n<=7 || c=='a' && n>=0 && n<=6) && p[2]==' ') {
+    if (!parse_hex(p+2, &value))
+      return 0;
+    if (c=='d')
+      user_data[n] = value;
+    else
+      user_addr[n] = value;
+    return 1;
+  }
+
+  for (j=0; j<4; j++) {
+    for (k=0; names[j][k] && (p[k]|0x20)==names[j][k]; k++)
+      continue;
+    if (names[j][k]==0 && p[k]==' ')
+      break;
+  }
+  if (j==4 || !parse_hex(p+k, &value))
+    return 0;
+
+  switch (j) {
+    case 0: user_usp = value; break;
+    case 1: user_ssp = value; break;
+    case 2: user_sr  = value; break;
+    case 3: if (value & 1)
+              return 0;
+            user_pc = save_PC = display_PC = curr_inst = value;
+            break;
+  }
+  return 1;
+}
+
+
+// Parse condition "src op value [mask]" at p for a breakpoint at address and set the
+// breakpoint if needed. src is d0-d7, a0-a6 or an address with .b, .w or .l, op is one
+// of = ! < >. Returns 0 on error.
+int parse_condition(ulong address, char *p)
+{
+  static const char ops[] = "=!<>";
+  char  c, d, n;
+  ulong src, value, mask;
+  ushort op;
+
+  p = skip_blanks(p);
+  c = p[0] | 0x20;
+  n = p[1] - '0';
+  d = p[2] | 0x20;
+  if ((c=='d' && n>=0 && n<=7 || c=='a' && n>=0 && n<=6) &&
+      !(d >= '0' && d <= '9' || d >= 'a' && d <= 'f' || d == '.')) {
+    src = c=='d' ? n : 8+n;
+    op  = COND_REG;
+    p  += 2;
+  }
+  else {
+    if (!(p = parse_hex(p, &src)) || *p++ != '.')
+      return 0;
+    c  = *p++ | 0x20;
+    op = c=='b' ? COND_B : c=='w' ? COND_W : c=='l' ? COND_L : 0;
+    if (!op || op != COND_B && (src & 1))
+      return 0;
+  }
+
+  p = skip_blanks(p);
+  for (n=0; n<4 && *p != ops[n]; n++)
+    continue;
+  if (n == 4 || !(p = parse_hex(p+1, &value)))
+    return 0;
+  op |= n + COND_EQ;
+  if (!parse_hex(p, &mask))
+    mask = 0xffffffffL;
+
+  if (address & 1 || !breakpoint_at(address) && num_bp >= MAX_BP)
+    return 0;
+  if (!set_condition(address, src, op, value & mask, mask))
+    return 0;
+  if (!breakpoint_at(address))
+    toggle_breakpoint(address);
+  return 1;
+}
+
+
+void command_help(void)
+{
+  pstring("a [addr]          show/set current address\r\n"
+          "d [addr [lines]]  hex dump\r\n"
+          "e addr bytes..    enter bytes\r\n"
+          "f start end byte  fill memory upto end\r\n"
+          "r [reg value]     show registers/set register\r\n"
+          "b [addr]          list/toggle breakpoint\r\n"
+          "b addr src op val conditional breakpoint\r\n"
+          "i addr count      ignore hits of breakpoint\r\n"
+          "w [addr.s [val]]  list/toggle watchpoint\r\n"
+          "g [addr]          go\r\n"
+          "t [addr]          step into\r\n"
+          "p [addr]          step over\r\n"
+          "u [addr [lines]]  disassemble\r\n"
+          "l                 load\r\n"
+          "q                 back to keypad\r\n"
+          "x [0|1]           XON/XOFF flow control\r\n"
+          "c [0|1]           cycles in disassembly\r\n"
+          "$                 GDB remote protocol\r\n");
+}
+
+
+////////////////////////////// GDB remote protocol ////////////////////////////////
+
+// Parse exactly digits hex digits at p, returns pointer behind them or 0
+char *parse_hexn(char *p, short digits, ulong *n)
+{
+  char c;
+
+  *n = 0;
+  while (digits--) {
+    c = *p++ | 0x20; // lower case
+    if (c >= '0' && c <= '9')
+      c -= '0';
+    else if (c >= 'a' && c <= 'f')
+      c -= 'a'-10;
+    else
+      return 0;
+    *n = *n<<4 | c;
+  }
+  return p;
+}
+
+
+// Storage of GDB register n except SR, A7 is the active stack pointer
+ulong *gdb_register(short n)
+{
+  if (n < 8)
+    return &user_data[n];
+  if (n < 15)
+    return &user_addr[n-8];
+  if (n == 15)
+    return (user_sr & 0x2000) ? &user_ssp : &user_usp;
+  return &user_pc;
+}
+
+
+// Signal number reported to GDB for the last exception
+char gdb_signal(void)
+{
+  static const char signals[] = {
+    5, 5, 10, 10, 4, 8, 8, 8, 4, 5, 4, 4, 5, 5 // TRAP, BUS, ILL, FPE
+  };
+  return exception_nr < sizeof(signals) ? signals[exception_nr] : 5;
+}
+
+
+// Send packet buf upto end, buf[0] is reserved for '$'
+void put_packet(char *buf, char *end)
+{
+  uchar sum = 0;
+  char  *p;
+
+  buf[0] = '$';
+  for (p=buf+1; p<end; p++)
+    sum += *p;
+  *end++ = '#';
+  end = hex2buf(end, sum, 2);
+  write_block(buf, end-buf);
+}
+
+
+// GDB remote serial protocol stub. Continue and step leave through the user
+// program, which returns to scan1 and from there back here with a stop reply.
+void gdb_stub(void)
+{
+  char  in[GDB_BUF];
+  char  out[GDB_BUF+4];
+  char  *p, *q;
+  ulong a, n, v;
+  short j;
+
+  if (cmd_mode == CMD_GDB) {
+    // back from user program, send stop reply
+    out[1] = 'S';
+    put_packet(out, hex2buf(out+2, gdb_signal(), 2));
+  }
+  cmd_mode = CMD_GDB;
+
+  while (cmd_mode == CMD_GDB) {
+    if (get_packet(in, sizeof(in)) < 0) {
+      send_byte('-'); // check sum error, please send again
+      continue;
+    }
+    send_byte('+');
+
+    p = out+1;
+    switch (in[0]) {
+      case '?':
+        *p++ = 'S';
+        p = hex2buf(p, gdb_signal(), 2);
+        break;
+
+      case 'g':
+        for (j=0; j<GDB_REGS; j++)
+          p = hex2buf(p, j==16 ? user_sr : *gdb_register(j), 8);
+        break;
+
+      case 'G':
+        q = in+1;
+        for (j=0; j<GDB_REGS && (q = parse_hexn(q, 8, &v)); j++) {
+          if (j==16)
+            user_sr = v;
+          else
+            *gdb_register(j) = v;
+        }
+        p = str2buf(p, "OK");
+        break;
+
+      case 'm':
+        q = parse_hex(in+1, &a);
+        if (q && *q==',' && parse_hex(q+1, &n) && n <= GDB_BUF/2) {
+          for (j=0; j<n; j++)
+            p = hex2buf(p, ((uchar *)a)[j], 2);
+        }
+        else
+          p = str2buf(p, "E01");
+        break;
+
+      case 'M':
+        q = parse_hex(in+1, &a);
+        if (q && *q==',' && (q = parse_hex(q+1, &n)) && *q==':') {
+          for (j=0, q++; j<n && (q = parse_hexn(q, 2, &v)); j++)
+            ((uchar *)a)[j] = v;
+          p = str2buf(p, j==n ? "OK" : "E01");
+        }
+        else
+          p = str2buf(p, "E01");
+        break;
+
+      case 'Z':
+      case 'z':
+        // Software breakpoints only, using the monitor's breakpoints
+        if (in[1]=='0' && in[2]==',' && parse_hex(in+3, &a)) {
+          if ((in[0]=='Z') != breakpoint_at(a)) {
+            if (a & 1 || in[0]=='Z' && num_bp >= MAX_BP) {
+              p = str2buf(p, "E01");
+              break;
+            }
+            toggle_breakpoint(a);
+          }
+          p = str2buf(p, "OK");
+        }
+        break;
+
+      case 'c':
+      case 's':
+        if (parse_hex(in+1, &a))
+          user_pc = a;
+        display_PC = user_pc;
+        exception_nr = 0;
+        state = STATE_INPUT_ADDR;
+        if (in[0]=='s')
+          step_into();
+        else if (breakpoint_at(display_PC))
+          step_then_go();
+        else
+          go();
+        break;
+
+      case 'k':
+        cmd_mode = 0; // no reply
+        key_address();
+        continue;
+
+      case 'D':
+        cmd_mode = 0;
+        key_address();
+        p = str2buf(p, "OK");
+        break;
+
+      case 'H':
+        p = str2buf(p, "OK");
+        break;
+
+      case 'q':
+        for (j=0; "qSupported"[j] && in[j]=="qSupported"[j]; j++)
+          continue;
+        if (j==10)
+          p = hex2buf(str2buf(p, "PacketSize="), GDB_BUF, 3);
+        break;
+    }
+    // Unsupported packets get an empty reply
+    put_packet(out, p);
+  }
+}
+
+
+// Line oriented command interpreter on the terminal, entered when a character
+// arrives while waiting for a key. Execution commands leave through the user
+// program, which returns to scan1 and from there back here.
+void command_line(void)
+{
+  char  buf[CMD_LEN];
+  char  *p, *q, cmd;
+  ulong a, b, c;
+  short n, ok;
+  ushort save_lines;
+
+  if (cmd_mode == CMD_LINE)
+    dump_disassembly(display_PC, 0); // back from user program
+  else {
+    purge_input(); // drop the character which woke us up
+    cmd_mode = CMD_LINE;
+  }
+
+  while (cmd_mode == CMD_LINE) {
+    flow_go();
+    write_block("> ", 2);
+    n = get_line(buf, sizeof(buf));
+    flow_stop();
+    write_block(buf, n); // echo complete line
+    newline();
+
+    p = skip_blanks(buf);
+    cmd = *p ? *p++ | 0x20 : 0;
+    q = parse_hex(p, &a);
+    ok = 1;
+
+    switch (cmd) {
+      case 0:
+        break;
+
+      case 'a':
+        if (q)
+          display_PC = curr_inst = a;
+        send_line(hex2buf(line, display_PC, 5));
+        key_address();
+        break;
+
+      case 'd':
+        save_lines = hexdump_lines;
+        if (q) {
+          display_PC = a;
+          if (parse_hex(q, &b) && b)
+            hexdump_lines = b;
+        }
+        dump_memory();
+        hexdump_lines = save_lines;
+        break;
+
+      case 'u':
+        save_lines = disasm_lines;
+        if (q) {
+          display_PC = a;
+          if (parse_hex(q, &b) && b)
+            disasm_lines = b;
+        }
+        disassemble_list();
+        disasm_lines = save_lines;
+        break;
+
+      case 'e':
+        if (!q || !parse_hex(q, &b))
+          ok = 0;
+        while (q && (q = parse_hex(q, &b)))
+          *(char *)a++ = b;
+        break;
+
+      case 'f':
+        if (q && (q = parse_hex(q, &b)) && parse_hex(q, &c) && a < b) {
+          while (a < b)
+            *(char *)a++ = c;
+        }
+        else
+          ok = 0;
+        break;
+
+      case 'r':
+        if (*skip_blanks(p))
+          ok = set_register(p);
+        else
+          dump_registers();
+        break;
+
+      case 'b':
+        if (q && *skip_blanks(q))
+          ok = parse_condition(a, q);
+        else if (q)
+          toggle_breakpoint(a);
+        if (ok)
+          dump_breakpoints();
+        break;
+
+      case 'i':
+        ok = q && parse_hex(q, &b) && set_ignore(a, b);
+        if (ok)
+          dump_breakpoints();
+        break;
+
+      case 'w':
+        if (q) {
+          // size suffix .b, .w or .l directly behind the address
+          c  = q[0] == '.' ? q[1] | 0x20 : 0;
+          n  = c=='b' ? 1 : c=='w' ? 2 : c=='l' ? 4 : 0;
+          ok = n != 0;
+          if (ok) {
+            c  = parse_hex(q+2, &b) != 0;
+            ok = toggle_watch(a, n, c, b);
+          }
+        }
+        if (ok)
+          dump_watchpoints();
+        break;
+
+      case 'g':
+      case 't':
+      case 'p':
+        if (q)
+          display_PC = a;
+        state = STATE_INPUT_ADDR;
+        if (cmd=='g') {
+          if (breakpoint_at(display_PC))
+            step_then_go();
+          else
+            go();
+        }
+        else if (cmd=='t')
+          step_into();
+        else {
+          key_user(); // returns only when skipping TRAP #0/#1
+          dump_disassembly(display_PC, 0);
+        }
+        break;
+
+      case 'l':
+        load_srecord();
+        break;
+
+      case 'q':
+        cmd_mode = 0;
+        key_address();
+        break;
+
+      case '$':
+        gdb_stub();
+        break;
+
+      case 'x':
+        if (q)
+          flow_control = a != 0;
+        pstring(flow_control ? "XON/XOFF on\r\n" : "XON/XOFF off\r\n");
+        break;
+
+      case 'c':
+        if (q)
+          disasm_cycles = a != 0;
+        pstring(disasm_cycles ? "cycles on\r\n" : "cycles off\r\n");
+        break;
+
+      default:
+        command_help();
+        break;
+    }
+
+    if (!ok)
+      pstring("error\r\n");
+  }
+}
+
+
 void scan1(void)
 {
   char raw_key;
 
+  if (cmd_mode == CMD_GDB) {
+    gdb_stub();     // back from user program started by GDB
+    return;
+  }
+  if (cmd_mode == CMD_LINE) {
+    command_line(); // back from user program started on the command line
+    return;
+  }
+
   while ((scan()!= -1) && ((*port0&0x40) !=0))
     continue;
-  delay(100);
+  scan(); // debounce, one more pass instead of a delay keeps the LEDs lit
 
-  while (scan() == -1)
-    continue;
-  delay(100);
+  while (scan() == -1) {
+    if ((*port0 & 0x80) == 0) {
+      // Start bit on RXD
+      command_line();
+      return;
+    }
+  }
 
+  scan(); // debounce
   raw_key = scan();
 
   // check key in range
@@ -1599,22 +3167,35 @@ void init_globals(void)
   beep_flag     = 0;
   hit_a6        = 0;
   edit_register = 0;
+  cmd_mode      = 0;
+  inst_anchor   = 0;
+  for (inst_cache_pos=0; inst_cache_pos<INST_CACHE; inst_cache_pos++)
+    inst_cache[inst_cache_pos] = 0;
+  inst_cache_pos = 0;
+  lcd_async     = 0;
+  lcd_lock      = 0;
+  lcd_pending   = 0;
+  key_irq       = 0;
+  key_last      = key_state = -1;
+  key_stable    = KEY_STABLE;
+  key_head      = key_tail = 0;
 
   if (magic != MAGIC) {
     // Initialize these variables only on power up, not on each reset.
     magic = MAGIC;
     disasm_lines  = 16;
     hexdump_lines = 16;
+    hexdump_width = 16;
+    hexdump_group = 1;
+    flow_control  = 0;
+    symbol_table  = 0;
+    disasm_cycles = 0;
+    num_watch     = 0;
     disasm_on_lcd = 1;
     enable_trap1  = 0;
 
-    //KH: Be sure the variable is initialized when board is reset
-    //>>>+++--- 2400 b1=0x1A   b2=0x2B   FB: b1 changed from 0x1B
-    //>>>+++--- 4800 b1=0x0A   b2=0x15   FB: b1 changed from 0x0B
-    //>>>+++--- 9600 b1=0x02   b2=0x06
-    //
-    glob_b1 = 0x02;
-    glob_b2 = 0x06;
+    // glob_b1 and glob_b2 are derived from the bit rate
+    set_baud(DEFAULT_BAUD);
 
     show_sr = 2; // symbolic format
 
@@ -1649,7 +3230,7 @@ void main(void)
   tick       = 0;
 
   pstring("\r\n68008 MICROPROCESSOR KIT (C)2016 "
-          "\r\nWith 9600 Baud Software UART!"
+          "\r\nWith auto-baud Software UART!"
           "\r\nextended " VERSION " by Fred Bayer"
           "\r\n");
 
@@ -0,0 +1,21 @@
+### Python script to convert a HEX file into a binary image for XMODEM download
+
+## The image starts at the lowest address in the HEX file, which is printed.
+## Press ADDR and enter this address on the Kit before pressing LOAD.
+##
+## usage: python makebin.py program.hex
+
+import sys
+import bincopy
+
+src  = sys.argv[1]
+dest = src.rsplit(".", 1)[0] + ".bin"
+
+prog = bincopy.BinFile(src)
+prog.fill()
+
+with open(dest, "wb") as out:
+  out.write(prog.as_binary())
+
+print("%s: %d bytes, load at %06X, entry at %06X" %
+      (dest, len(prog), prog.minimum_address, prog.execution_start_address or prog.minimum_address))
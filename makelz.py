@@ -0,0 +1,90 @@
+### Python script to compress a HEX file for download to the 68008 Kit
+
+## Creates an LZSS compressed image, which the monitor decompresses into RAM
+## while receiving it. Send the resulting file as raw binary after pressing LOAD.
+##
+## usage: python makelz.py [-m max_match] program.hex
+##
+## Format:
+##   'Z', 3 bytes load address, 3 bytes length, 1 byte header check sum
+##   LZSS stream, 2 bytes CRC-16/XMODEM of LZSS stream
+##
+## LZSS stream: a flag byte precedes each group of 8 items, LSB first.
+## Flag 1 is a literal byte, flag 0 a match of 2 bytes  oooooooo oooollll
+## copying l+3 bytes from offset o+1 bytes back.
+##
+## The full max_match of 18 works upto 9600 bit/s, use -m 8 at 19200 bit/s.
+## 38400 bit/s is too fast for the decompressor.
+
+import sys
+import binascii
+import bincopy
+
+WINDOW    = 4096
+MIN_MATCH = 3
+MAX_MATCH = 18
+MAX_CHAIN = 256
+
+
+def compress(data, max_match):
+  out   = bytearray()
+  heads = {}          # 3 byte prefix -> list of positions
+  pos   = 0
+  while pos < len(data):
+    flag_pos = len(out)
+    out.append(0)
+    for bit in range(8):
+      if pos >= len(data):
+        break
+      best_len, best_off = 0, 0
+      key = bytes(data[pos:pos+MIN_MATCH])
+      if len(key) == MIN_MATCH:
+        for cand in reversed(heads.get(key, [])[-MAX_CHAIN:]):
+          off = pos - cand
+          if off > WINDOW:
+            break
+          n = 0
+          while n < max_match and pos+n < len(data) and data[cand+n] == data[pos+n]:
+            n += 1
+          if n > best_len:
+            best_len, best_off = n, off
+            if n == max_match:
+              break
+      if best_len >= MIN_MATCH:
+        code = ((best_off-1) << 4) | (best_len-MIN_MATCH)
+        out += bytes([code >> 8, code & 0xff])
+        step = best_len
+      else:
+        out[flag_pos] |= 1 << bit
+        out.append(data[pos])
+        step = 1
+      for p in range(pos, pos+step):
+        heads.setdefault(bytes(data[p:p+MIN_MATCH]), []).append(p)
+      pos += step
+  return out
+
+
+args = sys.argv[1:]
+max_match = MAX_MATCH
+if args[0] == "-m":
+  max_match = max(MIN_MATCH, min(MAX_MATCH, int(args[1])))
+  args = args[2:]
+
+src  = args[0]
+dest = src.rsplit(".", 1)[0] + ".lz"
+
+prog = bincopy.BinFile(src)
+prog.fill()
+data    = prog.as_binary()
+address = prog.minimum_address
+stream  = compress(data, max_match)
+
+header = address.to_bytes(3, "big") + len(data).to_bytes(3, "big")
+check  = ~sum(header) & 0xff
+crc    = binascii.crc_hqx(bytes(stream), 0)
+
+with open(dest, "wb") as out:
+  out.write(b"Z" + header + bytes([check]) + stream + crc.to_bytes(2, "big"))
+
+print("%s: %d bytes at %06X compressed to %d bytes (%d%%)" %
+      (dest, len(data), address, len(stream)+10, 100*(len(stream)+10)//max(1, len(data))))
@@ -0,0 +1,64 @@
+### Python script to convert a symbol list into S-records for the disassembler
+
+## Each line of the input holds a name and a hex address in any order, like
+## "main 00812A", "$00812A main" or "main = 0x812a". Other lines are ignored.
+## The sorted table is written as S-records together with a pointer to it at
+## monitor variable symbol_table (00348). Download the result with LOAD, after
+## that disassembly listings show branch and PC-relative targets as name+offset.
+##
+## usage: python makesym.py [-a address] symbols.txt
+##
+## Format at address (default 01C000):
+##   'SY', word count, count entries of long address and 12 bytes name,
+##   sorted by address, names padded with zero bytes
+
+import re
+import sys
+
+SYMBOL_TABLE = 0x00348
+NAME_LEN     = 12
+
+address = 0x01C000
+args = sys.argv[1:]
+if len(args) == 3 and args[0] == "-a":
+  address = int(args[1], 16)
+  args = args[2:]
+if len(args) != 1:
+  sys.exit("usage: python makesym.py [-a address] symbols.txt")
+
+src  = args[0]
+dest = src.rsplit(".", 1)[0] + "_sym.hex"
+
+def parse_line(l):
+  name, addr = None, None
+  for tok in re.findall(r"[$\w.]+", l):
+    m = re.fullmatch(r"(?:\$|0x)?([0-9a-fA-F]+)", tok)
+    if addr is None and m and (tok[0] in "$0123456789" or tok.startswith("0x")):
+      addr = int(m.group(1), 16)
+    elif name is None and re.fullmatch(r"[A-Za-z_.][\w.]*", tok):
+      name = tok
+  return (addr & 0xffffff, name) if name and addr is not None else None
+
+symbols = {}
+with open(src, "r", errors="replace") as f:
+  for l in f:
+    s = parse_line(l)
+    if s:
+      symbols.setdefault(s[0], s[1])
+
+table = bytearray(b"SY") + len(symbols).to_bytes(2, "big")
+for addr in sorted(symbols):
+  table += addr.to_bytes(4, "big") + symbols[addr].encode()[:NAME_LEN].ljust(NAME_LEN, b"\0")
+
+def s2(addr, data):
+  rec = bytes([len(data) + 4]) + addr.to_bytes(3, "big") + data
+  return "S2%s%02X\n" % (rec.hex().upper(), ~sum(rec) & 0xff)
+
+with open(dest, "w") as out:
+  for i in range(0, len(table), 32):
+    out.write(s2(address + i, table[i:i+32]))
+  out.write(s2(SYMBOL_TABLE, address.to_bytes(4, "big")))
+  out.write("S804000000FB\n")
+
+print("%s: %d symbols, %d bytes at %06X-%06X" %
+      (dest, len(symbols), len(table), address, address + len(table) - 1))
@@ -10,8 +10,8 @@
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
            org         $40100
 
-sys_stack  equ         $20000          ; top of RAM, 1kb
-user_stack equ         $1fc00          ; USP 1k below SSP, enough space for system stack
+sys_stack  equ         $1fc00          ; below 1kb of monitor tables at top of RAM
+user_stack equ         $1f800          ; USP 1k below SSP, enough space for system stack
 
            section     code
 
@@ -51,6 +51,18 @@ sys_monitor_loop
            jmp         main_1
 sys_monitor_scan
            jmp         _scan
+sys_write
+           jmp         _write_block
+sys_crc32
+           jmp         _crc32
+sys_fletcher16
+           jmp         _fletcher16
+sys_decode_inst
+           jmp         _decode_inst
+sys_lcd_flush
+           jmp         _lcd_flush
+sys_get_key
+           jmp         _get_key
 
 
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
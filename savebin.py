@@ -0,0 +1,46 @@
+### Python script to extract a base64 memory save from a terminal log
+
+## Select the range with COPY, start address, +, end address and press LOAD
+## on the Kit while your terminal program logs to a file. The data is checked
+## by its CRC and written to a binary file named after the start address.
+##
+## usage: python savebin.py terminal.log
+
+import sys
+import base64
+import binascii
+
+src = sys.argv[1]
+
+with open(src, "r", errors="replace") as log:
+  lines = [l.strip() for l in log]
+
+start = [i for i, l in enumerate(lines) if l.startswith("B64 ")]
+if not start:
+  sys.exit("%s: no base64 save found" % src)
+
+i = start[-1]
+address, length = lines[i].split()[1:3]
+address = int(address, 16)
+length  = int(length)
+
+text = ""
+for l in lines[i+1:]:
+  if l.startswith("CRC "):
+    crc = int(l.split()[1], 16)
+    break
+  text += l
+else:
+  sys.exit("%s: CRC line missing" % src)
+
+data = base64.b64decode(text)
+if len(data) != length:
+  sys.exit("%s: got %d bytes, expected %d" % (src, len(data), length))
+if binascii.crc_hqx(data, 0) != crc:
+  sys.exit("%s: CRC error" % src)
+
+dest = "save_%05X.bin" % address
+with open(dest, "wb") as out:
+  out.write(data)
+
+print("%s: %d bytes from %05X" % (dest, length, address))
@@ -7,22 +7,80 @@
 trace_bit   equ     7
 system_bit  equ     5
 
+max_cond    equ     16                 ; MAX_COND in main.c
+max_watch   equ     4                  ; MAX_WATCH in main.c
+wp_old      equ     4*max_watch        ; offsets of watch_old, watch_target and
+wp_target   equ     8*max_watch        ; watch_mode from watch_addr, see main.c
+wp_mode     equ     12*max_watch
+
 
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 ;;; service interrupt level 2 for 68008 kit
-;;; increment tick every 10ms
+;;; increment tick every 10ms, scan keys and LEDs, send some dirty LCD cells
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 
-service_tick
+service_tick                           ; the soft UART isn't masked, keep the idle tick short
             addq.l  #1,_tick.w
+            tst.b   _key_irq.w
+            bne.s   .work
+            tst.b   _lcd_lock.w        ; lcd_dirty changed or flushed
+            bne.s   .idle
+            tst.b   _lcd_pending.w
+            bne.s   .work
+.idle       rte
+
+.work       movem.l d0-d1/a0-a1,-(a7)  ; scratch registers of C
+            tst.b   _key_irq.w
+            beq.s   .lcd
+            jsr     _key_tick          ; LEDs and key FIFO
+.lcd        tst.b   _lcd_lock.w
+            bne.s   .done
+            tst.b   _lcd_pending.w
+            beq.s   .done
+            jsr     _lcd_tick
+.done       movem.l (a7)+,d0-d1/a0-a1
             rte
 
 
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 ;;; Trace handler
+;;;
+;;; The fast path continues with 4 registers saved if no watchpoint triggered,
+;;; no breakpoint can be at the PC and the stack pointer says keep stepping.
+;;; Anything else is decided with all registers saved.
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 
 service_trace
+            movem.l d0-d1/a0-a1,-(a7) ; 16 bytes, then SR and PC
+            tst.w   _num_watch.w
+            beq.s   .fast_bp
+            bsr     check_watch
+            bne.s   .slow
+.fast_bp    move.w  20(a7),d0          ; low word of PC
+            lsr.w   #1,d0
+            andi.w  #$ff,d0            ; bit of bp_filter for bits 1-8 of PC
+            move.w  d0,d1
+            lsr.w   #3,d1
+            eori.w  #3,d1              ; byte within long, big endian
+            lea     _bp_filter.w,a0
+            btst    d0,0(a0,d1.w)
+            bne.s   .slow
+            tst.b   _frame_origin.w
+            bne.s   .fast_usp
+            lea     22(a7),a0          ; SSP of the program
+            bra.s   .fast_sp
+.fast_usp   move.l  usp,a0
+.fast_sp    tst.b   _step_mode.w
+            bne.s   .fast_out
+            cmpa.l  _call_frame.w,a0
+            bhs.s   .slow
+            bra.s   .fast
+.fast_out   cmpa.l  _call_frame.w,a0
+            bhi.s   .slow
+.fast       movem.l (a7)+,d0-d1/a0-a1
+            rte
+
+.slow       movem.l (a7)+,d0-d1/a0-a1
             move.w  #$2700,sr
             movem.l d0-d7/a0-a6,_user_data.w
             move.w  (a7)+,_user_sr.w
@@ -35,16 +93,17 @@ service_trace
             move.l  a1,_save_PC.w
             move.l  a1,_curr_inst.w
 
-            ; Check for matching breakpoint
-            move.w  _num_bp.w,d0
-            lea     _break_points.w,a0
-            bra.s   .loop
-.next       cmpa.l  (a0)+,a1
-            beq.s   to_monitor
-.loop       dbf     d0,.next
+            ; Check watchpoints, all registers are saved
+            tst.w   _num_watch.w
+            beq.s   .bp
+            bsr     check_watch
+            beq.s   .bp
+            jsr     _watch_stop        ; report and remember new values
+            bra.s   to_monitor
 
-            ; Check if the active SP has reached auto-step level again
-            tst.b   _frame_origin.w
+            ; Check if the active SP has reached auto-step level again. A step
+            ; which stops anyway doesn't count as hit of a breakpoint at the PC.
+.bp         tst.b   _frame_origin.w
             bne.s   .user_mode
             move.l  _user_ssp.w,a0
             bra.s   .cont
@@ -53,15 +112,32 @@ service_trace
             bne.s   returning
 
             cmpa.l  _call_frame.w,a0
-            blo     rest_regs          ; auto-step when still in call frame
+            blo.s   check_bp           ; auto-step when still in call frame
 
             ; SP has reached original level -> return to monitor
 to_monitor  jsr     _key_address
             jmp     main_1
 
 returning   cmpa.l  _call_frame.w,a0   ; stepping out
-            bls     rest_regs
-            bra.s   to_monitor
+            bhi.s   to_monitor
+
+            ; Check for matching breakpoint while auto-stepping
+check_bp    movea.l _user_pc.w,a1
+            move.w  a1,d0
+            lsr.w   #1,d0
+            andi.w  #$ff,d0            ; bit of bp_filter for bits 1-8 of PC
+            move.w  d0,d1
+            lsr.w   #3,d1
+            eori.w  #3,d1              ; byte within long, big endian
+            lea     _bp_filter.w,a0
+            btst    d0,0(a0,d1.w)
+            beq     rest_regs
+
+            bsr     find_bp
+            bmi     rest_regs
+            bsr     bp_hit
+            beq.s   to_monitor
+            bra     rest_regs
 
 
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
@@ -107,7 +183,184 @@ service_trap3
             move.w  (a7)+,_user_sr.w
             move.l  (a7)+,a1
             subq.l  #2,a1              ; adjust PC to re-execute broken opcode
-            bra.s   service_cont
+            bsr     find_bp
+            bmi.s   service_cont       ; TRAP #3 not set by the monitor
+            bsr     bp_hit
+            beq.s   service_cont
+
+            ; Condition false or hit ignored: restore only this breakpoint, execute
+            ; the original opcode in trace mode and let service_rearm patch it again
+            movea.l _orig_instr,a0
+            move.w  0(a0,d3.w),(a1)
+            move.l  a1,_bp_rearm.w
+            move.l  #service_rearm,$24 ; temporary vector for trace
+            move.l  a1,-(a7)
+            move.w  _user_sr.w,-(a7)
+            bset    #trace_bit,(a7)
+            movem.l _user_data.w,d0-d7/a0-a6
+            rte
+
+service_rearm                          ; trace after the opcode of a breakpoint
+            move.l  a0,-(a7)
+            movea.l _bp_rearm.w,a0
+            move.w  #$4e43,(a0)        ; patch with TRAP #3 again
+            movea.l (a7)+,a0
+            move.l  #service_trace,$24 ; restore original vector
+            bclr    #trace_bit,(a7)    ; continue at full speed
+            rte
+
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;;; Compare watched memory with the values seen before, see toggle_watch in
+;;; main.c. watch_old, watch_target and watch_mode follow watch_addr with
+;;; max_watch longs each. Returns Z clear if a watchpoint triggered.
+;;; Uses d0-d1/a0-a1.
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+check_watch
+            movea.l _watch_addr,a0
+            move.w  _num_watch.w,d0
+            subq.w  #1,d0
+.next       movea.l (a0),a1
+            moveq   #0,d1
+            cmpi.b  #2,wp_mode+2(a0)   ; size in bits 8-15 of watch_mode
+            blo.s   .byte
+            beq.s   .word
+            move.l  (a1),d1
+            bra.s   .cmp
+.word       move.w  (a1),d1
+            bra.s   .cmp
+.byte       move.b  (a1),d1
+.cmp        cmp.l   wp_old(a0),d1
+            beq.s   .same
+            btst    #0,wp_mode+3(a0)   ; WATCH_EQ, stop only at target
+            beq.s   .hit
+            cmp.l   wp_target(a0),d1
+            beq.s   .hit
+            move.l  d1,wp_old(a0)      ; changed to another value, go on
+.same       addq.l  #4,a0
+            dbf     d0,.next
+            moveq   #0,d0              ; Z set
+            rts
+.hit        moveq   #1,d0              ; Z clear
+            rts
+
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;;; Binary search for a1 in sorted break_points. Returns index * 2 in d3,
+;;; or -1 if there is no breakpoint at a1, with flags set. Uses d0-d3/a0.
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+find_bp
+            movea.l _break_points,a0
+            moveq   #0,d0              ; lower bound
+            move.w  _num_bp.w,d1       ; upper bound, exclusive
+.search     cmp.w   d1,d0
+            bhs.s   .none
+            move.w  d0,d2
+            add.w   d1,d2
+            lsr.w   #1,d2              ; middle
+            move.w  d2,d3
+            lsl.w   #2,d3
+            cmpa.l  0(a0,d3.w),a1
+            beq.s   .found
+            bhi.s   .upper
+            move.w  d2,d1              ; PC below middle
+            bra.s   .search
+.upper      addq.w  #1,d2              ; PC above middle
+            move.w  d2,d0
+            bra.s   .search
+.found      lsr.w   #1,d3              ; index * 2, N clear
+            rts
+.none       moveq   #-1,d3
+            rts
+
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;;; Breakpoint with index * 2 in d3 at a1 reached: check its condition, count
+;;; the hit and the ignore count. Returns Z set to stop, Z clear to continue.
+;;; Uses d0-d2/a0/a2.
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+bp_hit
+            bsr.s   bp_condition
+            bne.s   .done              ; condition false
+            movea.l _bp_hits,a0
+            addq.w  #1,0(a0,d3.w)
+            bcc.s   .ignore
+            subq.w  #1,0(a0,d3.w)      ; stay at FFFF
+.ignore     movea.l _bp_ignore,a0
+            tst.w   0(a0,d3.w)
+            beq.s   .done              ; stop
+            subq.w  #1,0(a0,d3.w)
+            moveq   #1,d0              ; Z clear
+.done       rts
+
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;;; Condition of the breakpoint at a1: (operand & mask) op value, unsigned,
+;;; see set_condition in main.c. Returns Z set to stop, Z clear to continue.
+;;; Breakpoints without condition always stop. Uses d0-d2/a0/a2.
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+bp_condition
+            movea.l _cond_addr,a0
+            moveq   #0,d1              ; offset of entry * 4
+            moveq   #max_cond-1,d0
+.find       cmpa.l  0(a0,d1.w),a1
+            beq.s   .found
+            addq.w  #4,d1
+            dbf     d0,.find
+            moveq   #0,d0              ; no condition, Z set
+            rts
+
+.found      movea.l _cond_src,a0
+            movea.l 0(a0,d1.w),a2      ; register number or address
+            movea.l _cond_op,a0
+            move.w  d1,d2
+            lsr.w   #1,d2
+            move.w  0(a0,d2.w),d2      ; size in high byte, op in low byte
+            moveq   #0,d0
+            cmpi.w  #$100,d2
+            bhs.s   .memory
+            move.w  a2,d0              ; D0-D7 and A0-A6 are saved in sequence
+            lsl.w   #2,d0
+            lea     _user_data.w,a0
+            move.l  0(a0,d0.w),d0
+            bra.s   .mask
+.memory     cmpi.w  #$200,d2
+            blo.s   .byte
+            beq.s   .word
+            move.l  (a2),d0
+            bra.s   .mask
+.word       move.w  (a2),d0
+            bra.s   .mask
+.byte       move.b  (a2),d0
+.mask       movea.l _cond_mask,a0
+            and.l   0(a0,d1.w),d0
+            movea.l _cond_value,a0
+            move.l  0(a0,d1.w),d1
+            cmpi.b  #1,d2
+            beq.s   .eq
+            cmpi.b  #2,d2
+            beq.s   .ne
+            cmpi.b  #3,d2
+            beq.s   .lt
+            cmp.l   d1,d0              ; >
+            bhi.s   .stop
+            bra.s   .cont
+.lt         cmp.l   d1,d0
+            blo.s   .stop
+            bra.s   .cont
+.ne         cmp.l   d1,d0
+            bne.s   .stop
+            bra.s   .cont
+.eq         cmp.l   d1,d0
+            beq.s   .stop
+.cont       moveq   #1,d0              ; Z clear
+            rts
+.stop       moveq   #0,d0              ; Z set
+            rts
 
 
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
@@ -195,7 +448,12 @@ service_step_then_go
             move.l  a1,_save_PC.w
             move.l  a1,_curr_inst.w
             move.l  #service_trace,$24   ; restore original vector
-            bra.s   _go
+            tst.w   _num_watch.w
+            beq.s   _go
+            bsr     check_watch        ; the opcode at the breakpoint may write too
+            beq.s   _go
+            jsr     _watch_stop        ; report and remember new values
+            bra     to_monitor
 
 
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
@@ -239,6 +497,8 @@ step_cont   bset    #trace_bit,_user_sr.w
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 
 _go
+            tst.w   _num_watch.w
+            bne.s   _step_cont         ; watchpoints are only checked in trace mode
             bsr.s   _arm_breakpoints
             bclr    #trace_bit,_user_sr.w
 
@@ -279,8 +539,8 @@ _arm_breakpoints
             tst.b   _bp_armed.w
             bne.s   .done
             move.w  _num_bp.w,d0
-            lea     _break_points.w,a0
-            lea     _orig_instr.w,a2
+            movea.l _break_points,a0
+            movea.l _orig_instr,a2
             bra.s   .loop
 .next       movea.l (a0)+,a1
             move.w  (a1),(a2)+           ; save original opcode
@@ -293,8 +553,8 @@ _disarm_breakpoints
             tst.b   _bp_armed.w
             beq.s   .done
             move.w  _num_bp.w,d0
-            lea     _break_points.w,a0
-            lea     _orig_instr.w,a2
+            movea.l _break_points,a0
+            movea.l _orig_instr,a2
             bra.s   .loop
 .next       movea.l (a0)+,a1
             move.w  (a2)+,(a1)           ; restore original opcode
@@ -303,6 +563,759 @@ _disarm_breakpoints
 .done       rts
 
 
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;;; Software UART, 8n1
+;;;
+;;; All state is kept in registers, so timing doesn't depend on RAM or
+;;; ROM wait states of variables. get_byte only uses the scratch registers
+;;; d0-d1/a0-a1 of C, a marker bit in d0 counts the data bits. Each bit takes exactly
+;;; 100 + 18 * glob_b1 cycles (68008, 4 cycles per byte fetched):
+;;;
+;;;   send_byte                      get_byte
+;;;   lsr.w   #1,d0        12        move.w  a1,d1        8
+;;;   subx.b  d2,d2         8        dbf (exit)          26
+;;;   ori.b   #$7f,d2      16        move.b  (a0),d1     12
+;;;   move.b  d2,(a0)      12        add.b   d1,d1        8
+;;;   move.w  a1,d2         8        roxr.b  #1,d0       12
+;;;   dbf (exit)           26        nop, nop            16
+;;;   dbf d1 (taken)       18        bcc.s (taken)       18
+;;;
+;;; The delay loop adds 18 cycles per count. These figures are the
+;;; UART_LOOP and UART_OVERHEAD constants in main.c.
+;;;
+;;; write_block sends a buffer with the same bit timing, the following
+;;; byte is fetched during the stop bit, so there is no gap between characters.
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+_send_byte                             ; void send_byte(char n)
+            move.l  d2,-(a7)
+            move.l  8(a7),d0           ; character in low byte
+            lea     $80002,a0          ; port1, TXD is bit 7
+            movea.l _glob_b1.w,a1      ; bit delay
+            andi.w  #$00ff,d0
+            ori.w   #$0100,d0          ; stop bit above data bits
+            add.w   d0,d0              ; start bit below data bits
+            moveq   #9,d1              ; start, 8 data, stop
+.bit        lsr.w   #1,d0              ; next bit into X
+            subx.b  d2,d2              ; $ff for 1, $00 for 0, no branch
+            ori.b   #$7f,d2            ; keep digit drivers and speaker off
+            move.b  d2,(a0)
+            move.w  a1,d2
+.delay      dbf     d2,.delay
+            dbf     d1,.bit
+            move.l  (a7)+,d2
+            rts
+
+
+_write_block                           ; void write_block(const char *buf, int len)
+            movem.l d2-d4/a2,-(a7)
+            movea.l 20(a7),a2          ; buffer
+            move.l  24(a7),d3          ; length
+            lea     $80002,a0          ; port1, TXD is bit 7
+            movea.l _glob_b1.w,a1      ; bit delay
+            move.l  a1,d4
+            subq.l  #2,d4              ; stop bit delay, next byte is set up during stop bit
+            bcc.s   .next
+            moveq   #0,d4
+            bra.s   .next
+
+.byte       moveq   #0,d0
+            move.b  (a2)+,d0
+            add.w   d0,d0              ; start bit below data bits
+            moveq   #8,d1              ; start and 8 data bits
+.bit        lsr.w   #1,d0              ; same timing as send_byte
+            subx.b  d2,d2
+            ori.b   #$7f,d2
+            move.b  d2,(a0)
+            move.w  a1,d2
+.delay      dbf     d2,.delay
+            dbf     d1,.bit
+            move.w  d4,d2
+            nop                        ; complete bit time of D7
+            move.b  #$ff,(a0)          ; stop bit
+.stop       dbf     d2,.stop
+.next       subq.l  #1,d3
+            bcc.s   .byte              ; next start bit follows without gap
+
+            movem.l (a7)+,d2-d4/a2
+            rts
+
+
+_get_byte                              ; char get_byte(void)
+            lea     $80000,a0          ; port0, RXD is bit 7
+get_next                               ; next byte, a0 still points to port0
+.idle       btst    #7,(a0)
+            beq.s   .idle              ; D7 of previous byte may still be on the line
+.start      btst    #7,(a0)
+            bne.s   .start             ; wait for start bit
+receive     movea.l _glob_b1.w,a1      ; bit delay
+            move.l  _glob_b2.w,d1      ; delay from start bit to center of D0
+            moveq   #0,d0
+            move.b  #$80,d0            ; marker, shifted out into C after 8 data bits
+.half       dbf     d1,.half
+            bra.s   .sample
+.bit        nop                        ; same bit time as send_byte
+            nop
+            move.w  a1,d1
+.delay      dbf     d1,.delay
+.sample     move.b  (a0),d1
+            add.b   d1,d1              ; RXD into X
+            roxr.b  #1,d0              ; LSB is received first
+            bcc.s   .bit
+            rts                        ; 64 cycles after sampling D7, 1.5 bits before the next start bit
+
+
+_get_byte_timeout                      ; int get_byte_timeout(ulong polls)
+            move.l  4(a7),d1           ; one poll takes 62 cycles
+            lea     $80000,a0
+.idle       btst    #7,(a0)
+            bne.s   .start             ; wait for stop bit of previous byte
+            subq.l  #1,d1
+            bne.s   .idle
+            bra.s   .timeout
+.start      btst    #7,(a0)
+            beq.s   receive            ; start bit, receive as get_byte
+            subq.l  #1,d1
+            bne.s   .start
+.timeout    moveq   #-1,d0
+            rts
+
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;;; Receive a line terminated by CR into buf, LF is ignored and BS or DEL delete
+;;; the previous character. Characters are not echoed, since the software UART
+;;; can't send while receiving. Returns the length of the line, which is
+;;; terminated by 0 and truncated to max-1 characters.
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+_get_line                              ; int get_line(char *buf, int max)
+            movem.l d2-d3/a2,-(a7)
+            movea.l 16(a7),a2          ; buffer
+            move.l  20(a7),d3
+            subq.l  #1,d3              ; room left, keep one for terminating 0
+.next       bsr     _get_byte
+            cmpi.b  #$0d,d0
+            beq.s   .end
+            cmpi.b  #$0a,d0
+            beq.s   .next
+            cmpi.b  #$08,d0
+            beq.s   .back
+            cmpi.b  #$7f,d0
+            beq.s   .back
+            tst.l   d3
+            beq.s   .next              ; buffer full, drop character
+            move.b  d0,(a2)+
+            subq.l  #1,d3
+            bra.s   .next
+.back       cmpa.l  16(a7),a2
+            beq.s   .next
+            subq.l  #1,a2
+            addq.l  #1,d3
+            bra.s   .next
+.end        clr.b   (a2)
+            move.l  a2,d0
+            sub.l   16(a7),d0
+            movem.l (a7)+,d2-d3/a2
+            rts
+
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;;; Receive a GDB remote protocol packet $data#cs into buf, without $ and #cs.
+;;; Anything before the $ (acknowledges, ^C) is skipped, a $ within the packet
+;;; starts it again. Returns the length of data, which is terminated by 0, or -1
+;;; on check sum error or when the packet doesn't fit into max-1 bytes.
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+_get_packet                            ; int get_packet(char *buf, int max)
+            movem.l d2-d5/a2-a3,-(a7)
+            lea     hex_value(pc),a3
+.sync       bsr     _get_byte
+            cmpi.b  #'$',d0
+            bne.s   .sync
+.start      movea.l 28(a7),a2          ; buffer
+            move.l  32(a7),d3
+            subq.l  #1,d3              ; room left, keep one for terminating 0
+            moveq   #0,d4              ; check sum
+            moveq   #0,d5              ; overflow flag
+.next       bsr     _get_byte
+            cmpi.b  #'#',d0
+            beq.s   .end
+            cmpi.b  #'$',d0
+            beq.s   .start
+            add.b   d0,d4
+            tst.l   d3
+            beq.s   .over
+            move.b  d0,(a2)+
+            subq.l  #1,d3
+            bra.s   .next
+.over       moveq   #-1,d5
+            bra.s   .next
+
+.end        bsr     _get_byte          ; two hex digits of check sum
+            move.b  0(a3,d0.w),d3
+            lsl.b   #4,d3
+            bsr     _get_byte
+            or.b    0(a3,d0.w),d3
+            clr.b   (a2)
+            cmp.b   d3,d4
+            bne.s   .error
+            tst.b   d5
+            bne.s   .error
+            move.l  a2,d0
+            sub.l   28(a7),d0
+            bra.s   .done
+.error      moveq   #-1,d0
+.done       movem.l (a7)+,d2-d5/a2-a3
+            rts
+
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;;; Receive a block of bytes into memory and compute CRC-16/XMODEM on the fly
+;;; (polynomial $1021, initial value 0). Returns the CRC or -1 on timeout.
+;;; The CRC update fits into the 1.5 bits left by receive.
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+_receive_block                         ; int receive_block(char *buf, int len, ulong polls)
+            movem.l d2-d5/a2-a3,-(a7)
+            movea.l 28(a7),a2          ; buffer
+            move.l  32(a7),d3          ; length
+            move.l  36(a7),d5          ; timeout for each byte
+            lea     crc16_table(pc),a3
+            moveq   #0,d4              ; CRC
+            bra.s   .next
+
+.byte       move.l  d5,d1
+            lea     $80000,a0          ; port0, RXD is bit 7
+.idle       btst    #7,(a0)
+            bne.s   .wait              ; stop bit of previous byte
+            subq.l  #1,d1
+            bne.s   .idle
+            bra.s   .timeout
+.wait       btst    #7,(a0)
+            beq.s   .rx
+            subq.l  #1,d1
+            bne.s   .wait
+.timeout    moveq   #-1,d0
+            bra.s   .done
+
+.rx         bsr     receive
+            move.b  d0,(a2)+
+            move.w  d4,d1
+            lsr.w   #8,d1
+            eor.b   d0,d1              ; (crc >> 8) ^ byte
+            andi.w  #$00ff,d1
+            add.w   d1,d1
+            lsl.w   #8,d4
+            move.w  0(a3,d1.w),d1
+            eor.w   d1,d4              ; (crc << 8) ^ table[...]
+.next       subq.l  #1,d3
+            bcc.s   .byte
+            moveq   #0,d0
+            move.w  d4,d0
+
+.done       movem.l (a7)+,d2-d5/a2-a3
+            rts
+
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;;; Update CRC-16/XMODEM crc with len bytes of memory at buf, start with crc 0
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+_crc16                                 ; ushort crc16(const char *buf, ulong len, ushort crc)
+            movem.l d2-d3/a2,-(a7)
+            movea.l 16(a7),a0          ; buffer
+            move.l  20(a7),d0          ; length
+            move.l  24(a7),d1          ; CRC
+            lea     crc16_table(pc),a2
+            bra.s   .next
+.byte       move.b  (a0)+,d3
+            move.w  d1,d2
+            lsr.w   #8,d2
+            eor.b   d3,d2              ; (crc >> 8) ^ byte
+            andi.w  #$00ff,d2
+            add.w   d2,d2
+            lsl.w   #8,d1
+            move.w  0(a2,d2.w),d2
+            eor.w   d2,d1              ; (crc << 8) ^ table[...]
+.next       subq.l  #1,d0
+            bcc.s   .byte
+            moveq   #0,d0
+            move.w  d1,d0
+            movem.l (a7)+,d2-d3/a2
+            rts
+
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;;; Update CRC-32 (as zip, polynomial $04c11db7 reflected) with len bytes of memory
+;;; at buf, start with crc 0. Table driven, 154 cycles per byte on the 68008,
+;;; about 1.0 s for 64 KB at 10 MHz.
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+_crc32                                 ; ulong crc32(const char *buf, ulong len, ulong crc)
+            movem.l d2-d3/a2,-(a7)
+            movea.l 16(a7),a0          ; buffer
+            move.l  20(a7),d0          ; length
+            move.l  24(a7),d1          ; CRC
+            not.l   d1
+            lea     crc32_table(pc),a2
+            bra.s   .next
+.byte       move.b  (a0)+,d2
+            eor.b   d1,d2              ; crc ^ byte
+            andi.w  #$00ff,d2
+            lsl.w   #2,d2
+            lsr.l   #8,d1
+            move.l  0(a2,d2.w),d3
+            eor.l   d3,d1              ; (crc >> 8) ^ table[...]
+.next       subq.l  #1,d0
+            bcc.s   .byte
+            not.l   d1
+            move.l  d1,d0
+            movem.l (a7)+,d2-d3/a2
+            rts
+
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;;; Fletcher-16 check sum of len bytes of memory at buf, both sums modulo 255.
+;;; Sums are reduced once per block, so the inner loop is just 3 instructions.
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+fletcher_block equ  200                ; sum2 must stay below 255*65536 for divu
+
+_fletcher16                            ; ushort fletcher16(const char *buf, ulong len)
+            movem.l d2-d4,-(a7)
+            movea.l 16(a7),a0          ; buffer
+            move.l  20(a7),d0          ; length
+            moveq   #0,d1              ; sum1
+            moveq   #0,d2              ; sum2
+            moveq   #0,d3
+.block      tst.l   d0
+            beq.s   .end
+            move.l  #fletcher_block,d4
+            cmp.l   d0,d4
+            bls.s   .count
+            move.l  d0,d4
+.count      sub.l   d4,d0
+            subq.w  #1,d4
+.byte       move.b  (a0)+,d3
+            add.w   d3,d1
+            add.l   d1,d2
+            dbf     d4,.byte
+            divu    #255,d1
+            clr.w   d1
+            swap    d1                 ; sum1 % 255
+            divu    #255,d2
+            clr.w   d2
+            swap    d2                 ; sum2 % 255
+            bra.s   .block
+.end        lsl.w   #8,d2
+            or.w    d2,d1
+            move.l  d1,d0
+            movem.l (a7)+,d2-d4
+            rts
+
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;;; Receive s-records upto and including the S7/S8/S9 end record
+;;;
+;;; c is the first character, already received. S1/S2/S3 data is stored while
+;;; receiving. stat holds records, bytes, lowest and highest address, entry
+;;; point, number of check sum errors and upto srec_errors addresses of bad
+;;; records. The caller clears it and sets the lowest address to $ffffffff.
+;;; The statistics are kept in registers and only written back at the end.
+;;;
+;;; After receive returns, the next byte may follow 1.5 bits later, 390
+;;; cycles at 38400 bit/s. The longest paths until get_next polls again
+;;; (68008 cycles, including the 64 of receive):
+;;;
+;;;   last address byte, then first data byte    352
+;;;   last address byte of S9, then check sum    346
+;;;   data record with check sum error           342
+;;;   count byte, then first address byte        328
+;;;   check sum of a data record, statistics     326
+;;;
+;;; So back-to-back records without line delays are received at all bit
+;;; rates of the monitor, upto 38400 bit/s.
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+srec_errors equ     8                  ; MAX_SREC_ERR in main.c
+srec_data   equ     $80000000          ; in srec_layout: S1-S3 carry data to store
+srec_end    equ     $00010000          ; S7-S9 end the load
+
+srec_layout                            ; flags and address bytes of S0-S9, 0 for unsupported types
+            dc.l    2,srec_data+2,srec_data+3,srec_data+4,0
+            dc.l    2,3,srec_end+4,srec_end+3,srec_end+2
+
+_load_srec                             ; void load_srec(int c, ulong *stat)
+            movem.l d2-d7/a2-a6,-(a7)
+            move.l  48(a7),d0
+            movea.l 52(a7),a3
+            move.l  (a3),d6            ; records
+            movea.l 4(a3),a4           ; bytes
+            movea.l 8(a3),a5           ; lowest address
+            movea.l 12(a3),a6
+            addq.l  #1,a6              ; end of the highest record
+            move.l  20(a3),d4
+            lsl.l   #2,d4              ; offset of the next bad record address
+            lea     $80000,a0          ; port0 for get_next
+            bra.s   .sync
+
+.indic      move.b  d6,$f0000          ; loading indicator, between records
+.skip       bsr     get_next
+.sync       cmpi.b  #'S',d0
+            bne.s   .indic
+
+            bsr     get_next
+            subi.b  #'0',d0
+            cmpi.b  #9,d0
+            bhi.s   .sync              ; no record type
+            lsl.w   #2,d0
+            move.l  (srec_layout,pc,d0.w),d2
+            beq.s   .skip              ; S4 is not supported
+            moveq   #0,d5              ; check sum
+            suba.l  a2,a2
+            bsr     get_hex
+            moveq   #0,d3
+            move.b  d7,d3
+            sub.w   d2,d3
+            subq.w  #1,d3              ; number of data bytes
+            bmi     .error             ; count too small for record type
+
+            bra.s   .anext
+.addr       bsr     get_hex
+            move.l  a2,d1
+            lsl.l   #8,d1
+            move.b  d7,d1
+            movea.l d1,a2
+.anext      dbf     d2,.addr
+            tst.l   d2
+            bmi.s   .store
+
+.snext      dbf     d3,.skipb          ; S0, S5-S9 carry no data to store
+            bsr     get_hex
+            addq.b  #1,d5              ; all bytes add up to $ff
+            bne.s   .error
+            btst    #16,d2
+            bne.s   .end
+            bra     .skip
+.skipb      bsr     get_hex
+            bra.s   .snext
+
+.error      cmpi.l  #4*srec_errors,d4
+            bcc.s   .count
+            move.l  a2,24(a3,d4.l)     ; address of bad record
+.count      addq.l  #4,d4
+            btst    #16,d2
+            beq     .skip
+            bra.s   .done              ; bad end record, no entry point
+
+.end        move.l  a2,16(a3)          ; entry point
+.done       move.l  d6,(a3)
+            move.l  a4,4(a3)
+            move.l  a5,8(a3)
+            subq.l  #1,a6
+            move.l  a6,12(a3)
+            lsr.l   #2,d4
+            move.l  d4,20(a3)
+            movem.l (a7)+,d2-d7/a2-a6
+            rts
+
+.store      move.w  d3,d2              ; keep count, data flag stays in the upper word
+            dbf     d3,.data
+            bra.s   .dsum
+.data       bsr     get_hex
+            move.b  d7,(a2)+
+            dbf     d3,.data
+.dsum       bsr     get_next           ; check sum inline, the statistics need the time
+            move.b  (hex_value,pc,d0.w),d7
+            lsl.b   #4,d7
+            bsr     get_next
+            or.b    (hex_value,pc,d0.w),d7
+            add.b   d7,d5
+            addq.b  #1,d5              ; all bytes add up to $ff
+            bne.s   .bad
+            tst.w   d2
+            beq     .skip              ; no data, not counted
+            addq.l  #1,d6              ; records
+            adda.w  d2,a4              ; bytes
+            cmpa.l  a6,a2
+            bls.s   .low
+            movea.l a2,a6              ; end of the highest record
+.low        suba.w  d2,a2              ; start of the record
+            cmpa.l  a5,a2
+            bcc     .skip
+            movea.l a2,a5              ; lowest address
+            bra     .skip
+.bad        suba.w  d2,a2              ; start of the bad record
+            bra     .error
+
+get_hex                                ; receive 2 hex digits into d7, add to check sum in d5
+            bsr     get_next
+            move.b  (hex_value,pc,d0.w),d7
+            lsl.b   #4,d7
+            bsr     get_next
+            or.b    (hex_value,pc,d0.w),d7
+            add.b   d7,d5
+            rts
+
+hex_value                              ; value of hex digits, indexed by character
+            dc.b    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0
+            dc.b    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0
+            dc.b    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0
+            dc.b    0,1,2,3,4,5,6,7,8,9,0,0,0,0,0,0
+            dc.b    0,10,11,12,13,14,15,0,0,0,0,0,0,0,0,0
+            dc.b    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0
+            dc.b    0,10,11,12,13,14,15,0,0,0,0,0,0,0,0,0
+            dc.b    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0
+            dc.b    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0
+            dc.b    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0
+            dc.b    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0
+            dc.b    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0
+            dc.b    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0
+            dc.b    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0
+            dc.b    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0
+            dc.b    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0
+
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;;; Receive an LZSS compressed stream and decompress it into memory on the fly
+;;;
+;;; A flag byte precedes each group of 8 items, LSB first. Flag 1 is a literal
+;;; byte, flag 0 a match of 2 bytes: oooooooo oooollll, copying l+3 bytes from
+;;; offset o+1 bytes back in the already decompressed data.
+;;; Returns CRC-16/XMODEM of the compressed stream or -1 on timeout.
+;;;
+;;; The next byte may follow 1.5 bits after receive returns, 781 cycles at
+;;; 19200 bit/s. Until .get polls again (68008 cycles, with the 64 of receive):
+;;;
+;;;   match of n bytes                          506 + 24*n
+;;;   literal, then a match                     394
+;;;   flag byte                                 390
+;;;
+;;; A match of 18 bytes takes 938 cycles, so the full match length needs
+;;; 9600 bit/s. 19200 bit/s works upto 8 bytes (698), use makelz.py -m 8.
+;;; 38400 bit/s (390) is too fast for the decompressor.
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+_receive_lz                            ; int receive_lz(char *dest, ulong len, ulong polls)
+            movem.l d2-d7/a2-a3,-(a7)
+            movea.l 36(a7),a2          ; destination
+            move.l  40(a7),d3          ; length of decompressed data
+            move.l  44(a7),d5          ; timeout for each byte
+            lea     crc16_table(pc),a3
+            moveq   #0,d4              ; CRC
+            moveq   #0,d6              ; flags above an end marker in bit 8
+
+.item       tst.l   d3
+            beq.s   .end
+            lsr.w   #1,d6
+            beq.s   .flags             ; only the end marker was left
+.kind       bcc.s   .match
+            bsr.s   .get               ; literal
+            move.b  d0,(a2)+
+            subq.l  #1,d3
+            bra.s   .item
+.flags      bsr.s   .get               ; next flag byte
+            move.b  d4,$f0000          ; loading indicator
+            move.w  d0,d6
+            ori.w   #$0100,d6
+            lsr.w   #1,d6
+            bra.s   .kind
+
+.match      bsr.s   .get
+            move.w  d0,d7
+            lsl.w   #4,d7
+            bsr.s   .get
+            move.b  d0,d1
+            lsr.b   #4,d1
+            or.b    d1,d7              ; offset-1
+            lea     -1(a2),a0
+            suba.w  d7,a0              ; source in decompressed data
+            andi.w  #$000f,d0
+            addq.w  #3,d0              ; length
+            sub.l   d0,d3
+            add.w   d0,d0
+            neg.w   d0
+            jmp     (.copied,pc,d0.w)  ; copy the last length bytes of 18
+            move.b  (a0)+,(a2)+
+            move.b  (a0)+,(a2)+
+            move.b  (a0)+,(a2)+
+            move.b  (a0)+,(a2)+
+            move.b  (a0)+,(a2)+
+            move.b  (a0)+,(a2)+
+            move.b  (a0)+,(a2)+
+            move.b  (a0)+,(a2)+
+            move.b  (a0)+,(a2)+
+            move.b  (a0)+,(a2)+
+            move.b  (a0)+,(a2)+
+            move.b  (a0)+,(a2)+
+            move.b  (a0)+,(a2)+
+            move.b  (a0)+,(a2)+
+            move.b  (a0)+,(a2)+
+            move.b  (a0)+,(a2)+
+            move.b  (a0)+,(a2)+
+            move.b  (a0)+,(a2)+
+.copied     bra.s   .item
+
+.end        moveq   #0,d0
+            move.w  d4,d0
+.done       movem.l (a7)+,d2-d7/a2-a3
+            rts
+
+.get        move.l  d5,d1              ; receive byte with timeout and update CRC
+            lea     $80000,a0
+.idle       btst    #7,(a0)
+            bne.s   .wait              ; stop bit of previous byte
+            subq.l  #1,d1
+            bne.s   .idle
+            bra.s   .timeout
+.wait       btst    #7,(a0)
+            beq.s   .rx
+            subq.l  #1,d1
+            bne.s   .wait
+.timeout    addq.l  #4,a7              ; drop return address
+            moveq   #-1,d0             ; timeout
+            bra.s   .done
+.rx         bsr     receive
+            ror.w   #8,d4              ; crc >> 8 in the low byte
+            eor.b   d0,d4
+            moveq   #0,d1
+            move.b  d4,d1
+            add.w   d1,d1
+            clr.b   d4                 ; crc << 8
+            move.w  0(a3,d1.w),d1
+            eor.w   d1,d4
+            rts
+
+
+crc16_table
+            dc.w    $0000,$1021,$2042,$3063,$4084,$50a5,$60c6,$70e7
+            dc.w    $8108,$9129,$a14a,$b16b,$c18c,$d1ad,$e1ce,$f1ef
+            dc.w    $1231,$0210,$3273,$2252,$52b5,$4294,$72f7,$62d6
+            dc.w    $9339,$8318,$b37b,$a35a,$d3bd,$c39c,$f3ff,$e3de
+            dc.w    $2462,$3443,$0420,$1401,$64e6,$74c7,$44a4,$5485
+            dc.w    $a56a,$b54b,$8528,$9509,$e5ee,$f5cf,$c5ac,$d58d
+            dc.w    $3653,$2672,$1611,$0630,$76d7,$66f6,$5695,$46b4
+            dc.w    $b75b,$a77a,$9719,$8738,$f7df,$e7fe,$d79d,$c7bc
+            dc.w    $48c4,$58e5,$6886,$78a7,$0840,$1861,$2802,$3823
+            dc.w    $c9cc,$d9ed,$e98e,$f9af,$8948,$9969,$a90a,$b92b
+            dc.w    $5af5,$4ad4,$7ab7,$6a96,$1a71,$0a50,$3a33,$2a12
+            dc.w    $dbfd,$cbdc,$fbbf,$eb9e,$9b79,$8b58,$bb3b,$ab1a
+            dc.w    $6ca6,$7c87,$4ce4,$5cc5,$2c22,$3c03,$0c60,$1c41
+            dc.w    $edae,$fd8f,$cdec,$ddcd,$ad2a,$bd0b,$8d68,$9d49
+            dc.w    $7e97,$6eb6,$5ed5,$4ef4,$3e13,$2e32,$1e51,$0e70
+            dc.w    $ff9f,$efbe,$dfdd,$cffc,$bf1b,$af3a,$9f59,$8f78
+            dc.w    $9188,$81a9,$b1ca,$a1eb,$d10c,$c12d,$f14e,$e16f
+            dc.w    $1080,$00a1,$30c2,$20e3,$5004,$4025,$7046,$6067
+            dc.w    $83b9,$9398,$a3fb,$b3da,$c33d,$d31c,$e37f,$f35e
+            dc.w    $02b1,$1290,$22f3,$32d2,$4235,$5214,$6277,$7256
+            dc.w    $b5ea,$a5cb,$95a8,$8589,$f56e,$e54f,$d52c,$c50d
+            dc.w    $34e2,$24c3,$14a0,$0481,$7466,$6447,$5424,$4405
+            dc.w    $a7db,$b7fa,$8799,$97b8,$e75f,$f77e,$c71d,$d73c
+            dc.w    $26d3,$36f2,$0691,$16b0,$6657,$7676,$4615,$5634
+            dc.w    $d94c,$c96d,$f90e,$e92f,$99c8,$89e9,$b98a,$a9ab
+            dc.w    $5844,$4865,$7806,$6827,$18c0,$08e1,$3882,$28a3
+            dc.w    $cb7d,$db5c,$eb3f,$fb1e,$8bf9,$9bd8,$abbb,$bb9a
+            dc.w    $4a75,$5a54,$6a37,$7a16,$0af1,$1ad0,$2ab3,$3a92
+            dc.w    $fd2e,$ed0f,$dd6c,$cd4d,$bdaa,$ad8b,$9de8,$8dc9
+            dc.w    $7c26,$6c07,$5c64,$4c45,$3ca2,$2c83,$1ce0,$0cc1
+            dc.w    $ef1f,$ff3e,$cf5d,$df7c,$af9b,$bfba,$8fd9,$9ff8
+            dc.w    $6e17,$7e36,$4e55,$5e74,$2e93,$3eb2,$0ed1,$1ef0
+
+
+crc32_table
+            dc.l    $00000000,$77073096,$ee0e612c,$990951ba
+            dc.l    $076dc419,$706af48f,$e963a535,$9e6495a3
+            dc.l    $0edb8832,$79dcb8a4,$e0d5e91e,$97d2d988
+            dc.l    $09b64c2b,$7eb17cbd,$e7b82d07,$90bf1d91
+            dc.l    $1db71064,$6ab020f2,$f3b97148,$84be41de
+            dc.l    $1adad47d,$6ddde4eb,$f4d4b551,$83d385c7
+            dc.l    $136c9856,$646ba8c0,$fd62f97a,$8a65c9ec
+            dc.l    $14015c4f,$63066cd9,$fa0f3d63,$8d080df5
+            dc.l    $3b6e20c8,$4c69105e,$d56041e4,$a2677172
+            dc.l    $3c03e4d1,$4b04d447,$d20d85fd,$a50ab56b
+            dc.l    $35b5a8fa,$42b2986c,$dbbbc9d6,$acbcf940
+            dc.l    $32d86ce3,$45df5c75,$dcd60dcf,$abd13d59
+            dc.l    $26d930ac,$51de003a,$c8d75180,$bfd06116
+            dc.l    $21b4f4b5,$56b3c423,$cfba9599,$b8bda50f
+            dc.l    $2802b89e,$5f058808,$c60cd9b2,$b10be924
+            dc.l    $2f6f7c87,$58684c11,$c1611dab,$b6662d3d
+            dc.l    $76dc4190,$01db7106,$98d220bc,$efd5102a
+            dc.l    $71b18589,$06b6b51f,$9fbfe4a5,$e8b8d433
+            dc.l    $7807c9a2,$0f00f934,$9609a88e,$e10e9818
+            dc.l    $7f6a0dbb,$086d3d2d,$91646c97,$e6635c01
+            dc.l    $6b6b51f4,$1c6c6162,$856530d8,$f262004e
+            dc.l    $6c0695ed,$1b01a57b,$8208f4c1,$f50fc457
+            dc.l    $65b0d9c6,$12b7e950,$8bbeb8ea,$fcb9887c
+            dc.l    $62dd1ddf,$15da2d49,$8cd37cf3,$fbd44c65
+            dc.l    $4db26158,$3ab551ce,$a3bc0074,$d4bb30e2
+            dc.l    $4adfa541,$3dd895d7,$a4d1c46d,$d3d6f4fb
+            dc.l    $4369e96a,$346ed9fc,$ad678846,$da60b8d0
+            dc.l    $44042d73,$33031de5,$aa0a4c5f,$dd0d7cc9
+            dc.l    $5005713c,$270241aa,$be0b1010,$c90c2086
+            dc.l    $5768b525,$206f85b3,$b966d409,$ce61e49f
+            dc.l    $5edef90e,$29d9c998,$b0d09822,$c7d7a8b4
+            dc.l    $59b33d17,$2eb40d81,$b7bd5c3b,$c0ba6cad
+            dc.l    $edb88320,$9abfb3b6,$03b6e20c,$74b1d29a
+            dc.l    $ead54739,$9dd277af,$04db2615,$73dc1683
+            dc.l    $e3630b12,$94643b84,$0d6d6a3e,$7a6a5aa8
+            dc.l    $e40ecf0b,$9309ff9d,$0a00ae27,$7d079eb1
+            dc.l    $f00f9344,$8708a3d2,$1e01f268,$6906c2fe
+            dc.l    $f762575d,$806567cb,$196c3671,$6e6b06e7
+            dc.l    $fed41b76,$89d32be0,$10da7a5a,$67dd4acc
+            dc.l    $f9b9df6f,$8ebeeff9,$17b7be43,$60b08ed5
+            dc.l    $d6d6a3e8,$a1d1937e,$38d8c2c4,$4fdff252
+            dc.l    $d1bb67f1,$a6bc5767,$3fb506dd,$48b2364b
+            dc.l    $d80d2bda,$af0a1b4c,$36034af6,$41047a60
+            dc.l    $df60efc3,$a867df55,$316e8eef,$4669be79
+            dc.l    $cb61b38c,$bc66831a,$256fd2a0,$5268e236
+            dc.l    $cc0c7795,$bb0b4703,$220216b9,$5505262f
+            dc.l    $c5ba3bbe,$b2bd0b28,$2bb45a92,$5cb36a04
+            dc.l    $c2d7ffa7,$b5d0cf31,$2cd99e8b,$5bdeae1d
+            dc.l    $9b64c2b0,$ec63f226,$756aa39c,$026d930a
+            dc.l    $9c0906a9,$eb0e363f,$72076785,$05005713
+            dc.l    $95bf4a82,$e2b87a14,$7bb12bae,$0cb61b38
+            dc.l    $92d28e9b,$e5d5be0d,$7cdcefb7,$0bdbdf21
+            dc.l    $86d3d2d4,$f1d4e242,$68ddb3f8,$1fda836e
+            dc.l    $81be16cd,$f6b9265b,$6fb077e1,$18b74777
+            dc.l    $88085ae6,$ff0f6a70,$66063bca,$11010b5c
+            dc.l    $8f659eff,$f862ae69,$616bffd3,$166ccf45
+            dc.l    $a00ae278,$d70dd2ee,$4e048354,$3903b3c2
+            dc.l    $a7672661,$d06016f7,$4969474d,$3e6e77db
+            dc.l    $aed16a4a,$d9d65adc,$40df0b66,$37d83bf0
+            dc.l    $a9bcae53,$debb9ec5,$47b2cf7f,$30b5ffe9
+            dc.l    $bdbdf21c,$cabac28a,$53b39330,$24b4a3a6
+            dc.l    $bad03605,$cdd70693,$54de5729,$23d967bf
+            dc.l    $b3667a2e,$c4614ab8,$5d681b02,$2a6f2b94
+            dc.l    $b40bbe37,$c30c8ea1,$5a05df1b,$2d02ef8d
+
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;;; Auto-baud: measure a CR character received on RXD
+;;;
+;;; CR is sent as start 1011 0000 stop (LSB first), so it has three low phases
+;;; and the rising edge after the last one is 9 bit times after the falling
+;;; edge of the start bit. Returns this time in samples, one sample takes
+;;; 50 cycles (SAMPLE_CYCLES in main.c).
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+_measure_frame
+            lea     $80000,a0          ; port0, RXD is bit 7
+            moveq   #0,d0
+            moveq   #2,d1              ; count low phases
+.idle       btst    #7,(a0)
+            bne.s   .idle              ; wait for start bit
+.low        addq.l  #1,d0              ; 12 cycles
+            btst    #7,(a0)            ; 20 cycles
+            beq.s   .low               ; 18 cycles
+            subq.w  #1,d1
+            bmi.s   .done
+.high       addq.l  #1,d0              ; same timing as above
+            btst    #7,(a0)
+            bne.s   .high
+            bra.s   .low
+.done       rts
+
+
 ; call from c program to make mask level to 1
 
 _enable_level2